@@ -0,0 +1,114 @@
+/*
+ * Battery life estimates from energy_simulate, the firmware's duty cycle
+ * run in simulated time over the default energy profile.
+ *
+ * Prints one row per sample period and radio setting, idling and in light
+ * sleep between wake windows; connection events follow link_policy for
+ * the sample period. The exit code is 1 if the estimates are not ordered
+ * the way the model implies (light sleep and longer periods never cost
+ * more), so it also serves as a regression test for the ledger.
+ *
+ *   energy_sim [battery_mah]
+ */
+
+/* Includes */
+/* STD APIs */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Energy model and the connection parameters it is run with */
+#include "energy_ledger.h"
+#include "link_policy.h"
+
+/* Defines */
+#define DEFAULT_BATTERY_MAH 2000
+#define DURATION_S 3600
+#define SENSOR_READ_MS 5
+#define PUBLISH_MS 2
+
+typedef enum {
+    RADIO_ADV_FAST = 0,
+    RADIO_ADV_SLOW,
+    RADIO_CONN_NO_LATENCY,
+    RADIO_CONN_POLICY,
+    RADIO_COUNT,
+} radio_t;
+
+/* Local variables */
+static const uint32_t sample_periods_ms[] = {2000, 10000, 60000};
+static const char* const radio_names[RADIO_COUNT] = {"adv fast", "adv slow", "conn no latency", "conn link_policy"};
+
+/* Advertising or connection event period the firmware would use, ms */
+static void radio_setting(radio_t radio, uint32_t period_ms, uint32_t* adv_itvl_ms, uint32_t* conn_event_ms) {
+    link_policy_t policy;
+    link_conn_params_t params;
+
+    *adv_itvl_ms = 0;
+    *conn_event_ms = 0;
+    switch (radio) {
+        case RADIO_ADV_FAST:
+            *adv_itvl_ms = LINK_FAST_ADV_ITVL_MIN_MS;
+            break;
+        case RADIO_ADV_SLOW:
+            *adv_itvl_ms = LINK_SLOW_ADV_ITVL_MIN_MS;
+            break;
+        case RADIO_CONN_NO_LATENCY:
+            *conn_event_ms = LINK_CONN_ITVL_MIN_MS;
+            break;
+        default:
+            link_policy_init(&policy, period_ms);
+            link_policy_conn_params(&policy, &params);
+            *conn_event_ms = (uint32_t)(params.latency + 1) * params.itvl_max * 5 / 4;
+            break;
+    }
+}
+
+static uint32_t run(uint32_t period_ms, radio_t radio, bool light_sleep, uint32_t battery_mah, uint32_t* hours) {
+    const energy_profile_t profile = ENERGY_PROFILE_DEFAULT;
+    energy_scenario_t scenario = {
+        .sample_period_ms = period_ms,
+        .sensor_read_ms = SENSOR_READ_MS,
+        .publish_ms = PUBLISH_MS,
+        .light_sleep = light_sleep,
+        .duration_s = DURATION_S,
+    };
+    energy_ledger_t ledger;
+
+    radio_setting(radio, period_ms, &scenario.adv_itvl_ms, &scenario.conn_event_ms);
+    energy_simulate(&scenario, &ledger);
+    *hours = energy_ledger_battery_hours(&ledger, &profile, battery_mah);
+    return energy_ledger_avg_ua(&ledger, &profile);
+}
+
+int main(int argc, char** argv) {
+    uint32_t battery_mah = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : DEFAULT_BATTERY_MAH;
+    size_t nperiods = sizeof(sample_periods_ms) / sizeof(sample_periods_ms[0]);
+    uint32_t avg[2][sizeof(sample_periods_ms) / sizeof(sample_periods_ms[0])][RADIO_COUNT];
+    bool ok = true;
+
+    printf("%" PRIu32 " mAh battery, %d s simulated per row\n", battery_mah, DURATION_S);
+    printf("%-8s %-18s %12s %10s %12s %10s\n", "period", "radio", "idle uA", "days", "sleep uA", "days");
+    for (size_t p = 0; p < nperiods; p++) {
+        for (int r = 0; r < RADIO_COUNT; r++) {
+            uint32_t idle_hours;
+            uint32_t sleep_hours;
+
+            avg[0][p][r] = run(sample_periods_ms[p], (radio_t)r, false, battery_mah, &idle_hours);
+            avg[1][p][r] = run(sample_periods_ms[p], (radio_t)r, true, battery_mah, &sleep_hours);
+            printf("%5" PRIu32 " s  %-18s %12" PRIu32 " %10.1f %12" PRIu32 " %10.1f\n", sample_periods_ms[p] / 1000,
+                   radio_names[r], avg[0][p][r], idle_hours / 24.0, avg[1][p][r], sleep_hours / 24.0);
+
+            if (avg[1][p][r] > avg[0][p][r]) {
+                printf("  light sleep costs more than idling\n");
+                ok = false;
+            }
+            if (p > 0 && (avg[0][p][r] > avg[0][p - 1][r] || avg[1][p][r] > avg[1][p - 1][r])) {
+                printf("  a longer sample period costs more\n");
+                ok = false;
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/*
+ * Transitions of the link policy state machine, driven the way gap.c
+ * drives it.
+ *
+ * Walks through boot, the fast advertising timeout, connecting with and
+ * without free slots, the central's answers to a parameter request, a
+ * notification period change and a bulk transfer, and checks each action
+ * against link_policy.h. Also checks the connection parameters for a range
+ * of notification periods against their bounds and the Bluetooth rule that
+ * the supervision timeout outlasts two wake periods. Prints one line per
+ * failed check; the exit code is 1 if there was any.
+ *
+ *   link_policy_test
+ */
+
+/* Includes */
+/* STD APIs */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Module under test */
+#include "link_policy.h"
+
+/* Defines */
+#define DEFAULT_NOTIFY_PERIOD_MS 2000
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+/* Local variables */
+static const uint32_t notify_periods_ms[] = {100, 500, 1000, 2000, 5000, 10000, 60000, 600000};
+static unsigned checks = 0;
+static unsigned failures = 0;
+
+/* Private functions */
+static void check(bool ok, const char* what, int line) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("line %d: %s\n", line, what);
+    }
+}
+
+static uint32_t adv_ms(uint16_t units) {
+    return (uint32_t)units * 625 / 1000;
+}
+
+static uint32_t itvl_ms(uint16_t units) {
+    return (uint32_t)units * 5 / 4;
+}
+
+/* Time between radio wake-ups of a connection, ms */
+static uint32_t wake_period_ms(const link_conn_params_t* params) {
+    return (uint32_t)(params->latency + 1) * itvl_ms(params->itvl_max);
+}
+
+static void handle(link_policy_t* policy, link_event_type_t type, link_action_t* action) {
+    link_event_t event = {.type = type};
+    link_policy_handle(policy, &event, action);
+}
+
+static void check_fast_adv(const link_action_t* action) {
+    CHECK(action->start_adv);
+    CHECK(adv_ms(action->adv_itvl_min) == LINK_FAST_ADV_ITVL_MIN_MS);
+    CHECK(adv_ms(action->adv_itvl_max) == LINK_FAST_ADV_ITVL_MAX_MS);
+    CHECK(action->adv_duration_ms == LINK_FAST_ADV_DURATION_MS);
+}
+
+static void check_slow_adv(const link_action_t* action) {
+    CHECK(action->start_adv);
+    CHECK(adv_ms(action->adv_itvl_min) == LINK_SLOW_ADV_ITVL_MIN_MS);
+    CHECK(adv_ms(action->adv_itvl_max) == LINK_SLOW_ADV_ITVL_MAX_MS);
+    CHECK(action->adv_duration_ms == LINK_DURATION_FOREVER);
+}
+
+static void check_bulk(const link_conn_params_t* params) {
+    CHECK(params->latency == 0);
+    CHECK(itvl_ms(params->itvl_max) <= LINK_BULK_ITVL_MAX_MS);
+    CHECK(params->itvl_min <= params->itvl_max);
+    CHECK(params->supervision_timeout * 10 == LINK_BULK_SUPERVISION_TIMEOUT_MS);
+}
+
+/* Bounds from link_policy.h for the parameters of one notification period */
+static void check_conn_params(uint32_t period_ms) {
+    link_policy_t policy;
+    link_conn_params_t params;
+    uint32_t wake;
+
+    link_policy_init(&policy, period_ms);
+    link_policy_conn_params(&policy, &params);
+    wake = wake_period_ms(&params);
+
+    CHECK(itvl_ms(params.itvl_min) >= LINK_CONN_ITVL_MIN_MS);
+    CHECK(itvl_ms(params.itvl_max) <= LINK_CONN_ITVL_MAX_MS);
+    CHECK(params.itvl_min <= params.itvl_max);
+    CHECK(params.latency <= LINK_MAX_LATENCY);
+    CHECK(params.supervision_timeout * 10 <= LINK_MAX_SUPERVISION_TIMEOUT_MS);
+    CHECK(params.supervision_timeout * 10 > 2 * wake);
+    /* At least one wake-up per notification, unless the bounds cannot reach that far */
+    CHECK(wake <= period_ms || params.latency == LINK_MAX_LATENCY);
+    /* Not waking much more often than needed either */
+    CHECK(wake * 2 > period_ms || params.latency == 0 || itvl_ms(params.itvl_max) >= LINK_CONN_ITVL_MAX_MS);
+    printf("%7" PRIu32 " ms: interval %" PRIu32 " ms, latency %u, wake every %" PRIu32 " ms, timeout %u ms\n",
+           period_ms, itvl_ms(params.itvl_max), (unsigned)params.latency, wake,
+           (unsigned)params.supervision_timeout * 10);
+}
+
+static void check_advertising(void) {
+    link_policy_t policy;
+    link_action_t action;
+    link_event_t connect = {.type = LINK_EVT_CONNECT, .slots_free = true};
+
+    link_policy_init(&policy, DEFAULT_NOTIFY_PERIOD_MS);
+
+    /* boot -> fast, fast timeout -> slow, disconnect -> fast again */
+    handle(&policy, LINK_EVT_BOOT, &action);
+    check_fast_adv(&action);
+    CHECK(!action.update_conn);
+    handle(&policy, LINK_EVT_ADV_TIMEOUT, &action);
+    check_slow_adv(&action);
+    handle(&policy, LINK_EVT_DISCONNECT, &action);
+    check_fast_adv(&action);
+
+    /* connect with a slot left: slow advertising and the notification parameters */
+    link_policy_handle(&policy, &connect, &action);
+    check_slow_adv(&action);
+    CHECK(action.update_conn);
+    CHECK(policy.adv_mode == LINK_ADV_SLOW);
+
+    /* connect taking the last slot: no advertising */
+    connect.slots_free = false;
+    link_policy_handle(&policy, &connect, &action);
+    CHECK(!action.start_adv);
+    CHECK(action.update_conn);
+
+    /* the last central leaves: fast again */
+    handle(&policy, LINK_EVT_DISCONNECT, &action);
+    check_fast_adv(&action);
+}
+
+static void check_conn_updates(void) {
+    link_policy_t policy;
+    link_action_t action;
+    link_conn_params_t wanted;
+    link_event_t update = {.type = LINK_EVT_CONN_UPDATE};
+    link_event_t connect = {.type = LINK_EVT_CONNECT};
+    link_event_t period = {.type = LINK_EVT_NOTIFY_PERIOD, .notify_period_ms = 10000};
+
+    link_policy_init(&policy, DEFAULT_NOTIFY_PERIOD_MS);
+    link_policy_conn_params(&policy, &wanted);
+    link_policy_handle(&policy, &connect, &action);
+    CHECK(memcmp(&action.conn, &wanted, sizeof(wanted)) == 0);
+
+    /* central granted what was asked: nothing more to do */
+    update.current = wanted;
+    link_policy_handle(&policy, &update, &action);
+    CHECK(!action.update_conn);
+
+    /* central kept its own fast interval without latency: ask again, but only so often */
+    update.current = (link_conn_params_t){.itvl_min = 24, .itvl_max = 24, .latency = 0, .supervision_timeout = 400};
+    for (uint8_t attempts = 0; attempts <= LINK_MAX_UPDATE_ATTEMPTS; attempts++) {
+        update.update_attempts = attempts;
+        link_policy_handle(&policy, &update, &action);
+        CHECK(action.update_conn == (attempts < LINK_MAX_UPDATE_ATTEMPTS));
+        if (action.update_conn) {
+            CHECK(memcmp(&action.conn, &wanted, sizeof(wanted)) == 0);
+        }
+    }
+
+    /* slower notifications: renegotiate for the new period and keep it */
+    link_policy_handle(&policy, &period, &action);
+    CHECK(action.update_conn);
+    CHECK(policy.notify_period_ms == period.notify_period_ms);
+    link_policy_conn_params(&policy, &wanted);
+    CHECK(memcmp(&action.conn, &wanted, sizeof(wanted)) == 0);
+    CHECK(wake_period_ms(&action.conn) > DEFAULT_NOTIFY_PERIOD_MS);
+
+    /* bulk transfer: shortest interval without latency */
+    handle(&policy, LINK_EVT_BULK_BEGIN, &action);
+    CHECK(action.update_conn);
+    check_bulk(&action.conn);
+
+    /* an answer during the transfer is judged against the bulk parameters */
+    update.bulk = true;
+    update.update_attempts = 0;
+    update.current = action.conn;
+    link_policy_handle(&policy, &update, &action);
+    CHECK(!action.update_conn);
+    update.current = wanted;
+    link_policy_handle(&policy, &update, &action);
+    CHECK(action.update_conn);
+    check_bulk(&action.conn);
+
+    /* transfer done: back to the notification parameters */
+    handle(&policy, LINK_EVT_BULK_END, &action);
+    CHECK(action.update_conn);
+    CHECK(memcmp(&action.conn, &wanted, sizeof(wanted)) == 0);
+    CHECK(!action.start_adv);
+}
+
+int main(void) {
+    check_advertising();
+    check_conn_updates();
+    for (size_t i = 0; i < sizeof(notify_periods_ms) / sizeof(notify_periods_ms[0]); i++) {
+        check_conn_params(notify_periods_ms[i]);
+    }
+    printf("%u checks, %u failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/*
+ * Compression ratio and cost of sample_codec, the way sensor_log uses it.
+ *
+ * Synthetic samples every 2 s are packed into SENSOR_LOG_CHUNK_PAYLOAD_MAX
+ * byte payloads, each starting from its first sample's timestamp, then
+ * decoded again and compared. Reports bits per sample inside the stream,
+ * flash bytes per sample including the chunk header and padding, how long
+ * the sensorlog partition lasts, and encode/decode time per sample. The
+ * exit code is 1 if any sample does not survive the round trip.
+ *
+ *   sample_codec_bench [samples]
+ */
+
+/* Includes */
+/* STD APIs */
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Codec and log geometry */
+#include "sample_codec.h"
+#include "sensor_log.h"
+
+/* Defines */
+#define DEFAULT_SAMPLES 200000
+#define SAMPLE_PERIOD_S 2
+#define PARTITION_SIZE (2 * 1024 * 1024)
+#define DECODE_REPEAT 10
+
+typedef struct {
+    const char* name;
+    unsigned temperature_noise; /* +- tenths per sample, uniform */
+    unsigned humidity_noise;
+    unsigned jitter_permille; /* samples whose whole second timestamp lands one off */
+} profile_t;
+
+typedef struct {
+    uint32_t first_ts;
+    uint16_t count;
+    uint16_t len;
+} chunk_t;
+
+/* Local variables */
+static const profile_t profiles[] = {
+    {"indoor", 1, 2, 20},
+    {"noisy", 3, 8, 100},
+};
+
+static sample_t* samples;
+static uint8_t* payloads;
+static chunk_t* chunks;
+
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int noise(uint32_t* rng, unsigned amplitude) {
+    return amplitude ? (int)(next_random(rng) % (2 * amplitude + 1)) - (int)amplitude : 0;
+}
+
+/* Daily swing of 3 C and 15 %RH with sensor noise on top, in tenths */
+static void generate(const profile_t* p, size_t n) {
+    uint32_t rng = 0x2545F491;
+    uint32_t ts = 1700000000;
+
+    for (size_t i = 0; i < n; i++) {
+        double day = 2.0 * M_PI * (double)(i * SAMPLE_PERIOD_S) / 86400.0;
+        int jitter = next_random(&rng) % 1000 < p->jitter_permille ? 1 : 0;
+
+        samples[i].seq = (uint32_t)i;
+        samples[i].timestamp = ts + (uint32_t)jitter;
+        samples[i].temperature = (int16_t)(215 + lround(15.0 * sin(day)) + noise(&rng, p->temperature_noise));
+        samples[i].humidity = (uint16_t)(450 - lround(75.0 * sin(day)) + noise(&rng, p->humidity_noise));
+        ts += SAMPLE_PERIOD_S;
+    }
+}
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* Pack all samples into chunk payloads the way sensor_log_append does */
+static size_t encode_all(size_t n, size_t* stream_bits) {
+    sample_encoder_t enc;
+    size_t nchunks = 0;
+
+    *stream_bits = 0;
+    for (size_t i = 0; i < n;) {
+        uint8_t* buf = payloads + nchunks * SENSOR_LOG_CHUNK_PAYLOAD_MAX;
+
+        sample_encoder_init(&enc, buf, SENSOR_LOG_CHUNK_PAYLOAD_MAX, samples[i].timestamp);
+        chunks[nchunks].first_ts = samples[i].timestamp;
+        while (i < n && sample_encoder_put(&enc, &samples[i])) {
+            i++;
+        }
+        chunks[nchunks].count = enc.count;
+        chunks[nchunks].len = (uint16_t)sample_encoder_bytes(&enc);
+        *stream_bits += enc.bits;
+        nchunks++;
+    }
+    return nchunks;
+}
+
+/* Decode every chunk; returns the number of samples that differ */
+static size_t decode_all(size_t nchunks, bool check, uint32_t* sink) {
+    sample_decoder_t dec;
+    sample_t s;
+    size_t i = 0;
+    size_t bad = 0;
+
+    for (size_t c = 0; c < nchunks; c++) {
+        sample_decoder_init(&dec, payloads + c * SENSOR_LOG_CHUNK_PAYLOAD_MAX, chunks[c].len, chunks[c].first_ts,
+                            chunks[c].count);
+        while (sample_decoder_next(&dec, &s)) {
+            *sink += s.timestamp + (uint32_t)s.temperature + s.humidity;
+            if (check && (s.timestamp != samples[i].timestamp || s.temperature != samples[i].temperature ||
+                          s.humidity != samples[i].humidity)) {
+                bad++;
+            }
+            i++;
+        }
+    }
+    return bad;
+}
+
+static bool run_profile(const profile_t* p, size_t n) {
+    size_t stream_bits;
+    uint32_t sink = 0;
+
+    generate(p, n);
+
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    size_t nchunks = encode_all(n, &stream_bits);
+    uint64_t enc_cycles = cycles() - c0;
+    double enc_ns = now_ns() - t0;
+
+    size_t bad = decode_all(nchunks, true, &sink);
+
+    t0 = now_ns();
+    c0 = cycles();
+    for (int r = 0; r < DECODE_REPEAT; r++) {
+        decode_all(nchunks, false, &sink);
+    }
+    uint64_t dec_cycles = (cycles() - c0) / DECODE_REPEAT;
+    double dec_ns = (now_ns() - t0) / DECODE_REPEAT;
+
+    double flash_per_sample = (double)(nchunks * SENSOR_LOG_CHUNK_SIZE) / (double)n;
+    double days = (double)PARTITION_SIZE / flash_per_sample * SAMPLE_PERIOD_S / 86400.0;
+
+    printf("%-7s samples=%zu chunks=%zu %.2f samples/chunk\n", p->name, n, nchunks, (double)n / (double)nchunks);
+    printf("%-7s stream %.2f bits/sample (raw sample_t %zu bytes: %.1fx), flash %.2f bytes/sample\n", "",
+           (double)stream_bits / (double)n, sizeof(sample_t), sizeof(sample_t) * 8.0 * n / (double)stream_bits,
+           flash_per_sample);
+    printf("%-7s %d KiB partition at %d s: %.1f days\n", "", PARTITION_SIZE / 1024, SAMPLE_PERIOD_S, days);
+    printf("%-7s encode %.1f ns/sample", "", enc_ns / (double)n);
+    if (enc_cycles) {
+        printf(" %.1f cycles/sample", (double)enc_cycles / (double)n);
+    }
+    printf(", decode %.1f ns/sample", dec_ns / (double)n);
+    if (dec_cycles) {
+        printf(" %.1f cycles/sample", (double)dec_cycles / (double)n);
+    }
+    printf(" (sink %" PRIu32 ")\n", sink & 0xFF);
+    if (bad) {
+        printf("%-7s %zu samples did not survive the round trip\n", "", bad);
+    }
+    return bad == 0;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_SAMPLES;
+    bool ok = true;
+
+    if (n == 0) {
+        return 2;
+    }
+    samples = calloc(n, sizeof(*samples));
+    /* Worst case a sample per chunk */
+    payloads = calloc(n, SENSOR_LOG_CHUNK_PAYLOAD_MAX);
+    chunks = calloc(n, sizeof(*chunks));
+    if (!samples || !payloads || !chunks) {
+        perror("calloc");
+        return 2;
+    }
+
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        ok &= run_profile(&profiles[i], n);
+    }
+
+    free(samples);
+    free(payloads);
+    free(chunks);
+    return ok ? 0 : 1;
+}
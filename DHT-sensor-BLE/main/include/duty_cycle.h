@@ -0,0 +1,52 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+/*
+ * Wake windows and automatic light sleep.
+ *
+ * Periodic samples are aligned to a fixed grid of DUTY_CYCLE_PERIOD_MS, and
+ * everything a sample triggers (sensor read, history, flash log,
+ * notifications, advertising data, deferred log output) runs inside one
+ * wake window. The window holds a no-light-sleep PM lock; in between the
+ * power management framework puts the chip into light sleep whenever
+ * FreeRTOS is idle and the BLE controller wakes it for radio events.
+ *
+ * Needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE. Whether the
+ * controller may sleep between radio events depends on the target's BLE
+ * low power clock; without either, the windows still group the work and
+ * the ledger books the time between them as idle.
+ *
+ * Time in each state and radio activity go into an energy ledger.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdint.h>
+
+/* Energy states */
+#include "energy_ledger.h"
+
+/* Sample period */
+#include "sampler.h"
+
+/* Defines */
+#define DUTY_CYCLE_PERIOD_MS SAMPLER_PERIOD_MS
+/* Fallback drain of the deferred log; windows and the ring's high-water mark drain it first */
+#define DUTY_CYCLE_LOG_DRAIN_MS 60000
+/* Battery used for the life estimate in duty_cycle_dump */
+#define DUTY_CYCLE_BATTERY_MAH 2000
+
+/* Public function declarations */
+void duty_cycle_init(void);
+/* First grid point at or after the given time */
+int64_t duty_cycle_align_us(int64_t time_us);
+void duty_cycle_window_begin(void);
+/* Change state inside a window, e.g. to ENERGY_STATE_SENSOR for the read */
+void duty_cycle_set_state(energy_state_t state);
+void duty_cycle_window_end(void);
+/* Radio activity for the ledger */
+void duty_cycle_radio_period(energy_event_t event, uint32_t period_us);
+void duty_cycle_radio_event(energy_event_t event);
+void duty_cycle_dump(void);
+
+#endif  // DUTY_CYCLE_H
@@ -0,0 +1,99 @@
+#ifndef ENERGY_LEDGER_H
+#define ENERGY_LEDGER_H
+
+/*
+ * Software energy ledger.
+ *
+ * Time is split into CPU states, each with a configured current, and the
+ * radio adds a fixed charge per event. Radio events are periodic sources
+ * (advertising, connection events) accrued from their interval, or counted
+ * one by one (notifications). Charge is the sum of state time x current
+ * plus events x charge per event; nothing is measured.
+ *
+ * The default profile is a rough ESP32-C3 with an AM2301 attached and is
+ * meant to compare settings against each other, not to replace a power
+ * analyser.
+ *
+ * energy_simulate runs the same duty cycle the firmware uses in simulated
+ * time and books it into a ledger, so battery life for different sample
+ * and connection settings can be estimated on a host (host/energy_sim).
+ *
+ * Pure C without ESP-IDF dependencies, so it also builds on a host.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    ENERGY_STATE_SLEEP = 0, /* automatic light sleep */
+    ENERGY_STATE_IDLE,      /* awake, nothing to run */
+    ENERGY_STATE_ACTIVE,    /* CPU running */
+    ENERGY_STATE_SENSOR,    /* CPU running, sensor transaction */
+    ENERGY_STATE_COUNT,
+} energy_state_t;
+
+typedef enum {
+    ENERGY_EVENT_ADV = 0, /* advertising event on three channels */
+    ENERGY_EVENT_CONN,    /* connection event without payload */
+    ENERGY_EVENT_NOTIFY,  /* extra for a notification in a connection event */
+    ENERGY_EVENT_COUNT,
+} energy_event_t;
+
+typedef struct {
+    uint32_t state_ua[ENERGY_STATE_COUNT];
+    uint32_t event_uc[ENERGY_EVENT_COUNT];
+} energy_profile_t;
+
+#define ENERGY_PROFILE_DEFAULT                                   \
+    {                                                            \
+        .state_ua = {                                            \
+            [ENERGY_STATE_SLEEP] = 350,                          \
+            [ENERGY_STATE_IDLE] = 15000,                         \
+            [ENERGY_STATE_ACTIVE] = 25000,                       \
+            [ENERGY_STATE_SENSOR] = 26500,                       \
+        },                                                       \
+        .event_uc = {                                            \
+            [ENERGY_EVENT_ADV] = 250,                            \
+            [ENERGY_EVENT_CONN] = 90,                            \
+            [ENERGY_EVENT_NOTIFY] = 30,                          \
+        },                                                       \
+    }
+
+typedef struct {
+    energy_state_t state;
+    int64_t since_us;
+    uint64_t state_us[ENERGY_STATE_COUNT];
+    uint32_t events[ENERGY_EVENT_COUNT];
+    uint32_t period_us[ENERGY_EVENT_COUNT]; /* 0 for events counted one by one */
+    uint32_t accrued_us[ENERGY_EVENT_COUNT];
+} energy_ledger_t;
+
+/* Duty cycle to simulate, ms */
+typedef struct {
+    uint32_t sample_period_ms;
+    uint32_t sensor_read_ms;  /* sensor transaction */
+    uint32_t publish_ms;      /* formatting, flash log, notify fan-out */
+    uint32_t adv_itvl_ms;     /* 0: not advertising */
+    uint32_t conn_event_ms;   /* connection interval x (latency + 1), 0: not connected */
+    bool light_sleep;         /* sleep between wake windows instead of idling */
+    uint32_t duration_s;
+} energy_scenario_t;
+
+/* Public function declarations */
+void energy_ledger_init(energy_ledger_t* ledger, energy_state_t state, int64_t now_us);
+/* Book the time since the last call to the current state, then switch */
+void energy_ledger_enter(energy_ledger_t* ledger, energy_state_t state, int64_t now_us);
+void energy_ledger_count(energy_ledger_t* ledger, energy_event_t event, uint32_t count);
+/* Periodic radio source, 0 stops it */
+void energy_ledger_set_period(energy_ledger_t* ledger, energy_event_t event, uint32_t period_us, int64_t now_us);
+
+uint64_t energy_ledger_elapsed_us(const energy_ledger_t* ledger);
+uint64_t energy_ledger_charge_uc(const energy_ledger_t* ledger, const energy_profile_t* profile);
+uint32_t energy_ledger_avg_ua(const energy_ledger_t* ledger, const energy_profile_t* profile);
+uint32_t energy_ledger_battery_hours(const energy_ledger_t* ledger, const energy_profile_t* profile, uint32_t capacity_mah);
+
+void energy_simulate(const energy_scenario_t* scenario, energy_ledger_t* ledger);
+
+#endif  // ENERGY_LEDGER_H
@@ -0,0 +1,53 @@
+#ifndef ESS_TRIGGER_H
+#define ESS_TRIGGER_H
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+/* Environmental Sensing Service trigger conditions (ES Trigger Setting descriptor) */
+typedef enum {
+    ESS_TRIGGER_INACTIVE = 0x00,
+    ESS_TRIGGER_FIXED_INTERVAL = 0x01,   /* operand: uint24 seconds */
+    ESS_TRIGGER_MIN_INTERVAL = 0x02,     /* no less than operand seconds apart */
+    ESS_TRIGGER_VALUE_CHANGED = 0x03,    /* optional operand: deadband */
+    ESS_TRIGGER_LESS_THAN = 0x04,        /* operand: characteristic value */
+    ESS_TRIGGER_LESS_OR_EQUAL = 0x05,
+    ESS_TRIGGER_GREATER_THAN = 0x06,
+    ESS_TRIGGER_GREATER_OR_EQUAL = 0x07,
+    ESS_TRIGGER_EQUAL = 0x08,
+    ESS_TRIGGER_NOT_EQUAL = 0x09,
+} ess_trigger_condition_t;
+
+#define ESS_TRIGGER_MAX_LEN 4
+
+/*
+ * One trigger setting and the state needed to evaluate it. Values are in
+ * the unit of the characteristic (0.01 °C or 0.01 %), times in seconds.
+ *
+ * ESS_TRIGGER_VALUE_CHANGED accepts an optional operand in the format of
+ * the characteristic and treats it as a deadband: a notification is only
+ * sent once the value moved by at least that much since the last one.
+ * Comparison conditions (0x04-0x09) notify when the condition becomes
+ * true, i.e. when the value crosses the threshold, not on every sample.
+ */
+typedef struct {
+    uint8_t condition;
+    bool has_operand;
+    int32_t operand;
+    bool has_last;
+    bool last_match;
+    int32_t last_value;
+    uint32_t last_time;
+} ess_trigger_t;
+
+/* Public function declarations */
+void ess_trigger_init(ess_trigger_t* trigger, uint8_t condition, int32_t operand);
+int ess_trigger_parse(ess_trigger_t* trigger, const uint8_t* buf, size_t len, bool value_signed);
+size_t ess_trigger_encode(const ess_trigger_t* trigger, uint8_t* buf);
+bool ess_trigger_evaluate(ess_trigger_t* trigger, int32_t value, uint32_t now);
+
+#endif  // ESS_TRIGGER_H
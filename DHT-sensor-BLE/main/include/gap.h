@@ -7,17 +7,42 @@
 #define GAP_SVC_H
 
 /* Includes */
+/* STD APIs */
+#include <stdbool.h>
+
 /* NimBLE GAP APIs */
 #include "host/ble_gap.h"
 #include "services/gap/ble_svc_gap.h"
 
+/* Sample types */
+#include "sample_history.h"
+
 /* Defines */
 #define BLE_GAP_APPEARANCE_GENERIC_TAG 0x0200
 #define BLE_GAP_URI_PREFIX_HTTPS 0x17
 #define BLE_GAP_LE_ROLE_PERIPHERAL 0x00
 
+/*
+ * Broadcaster mode: the latest reading is always in the advertising data.
+ * Set to 0 to advertise non-connectable only, 1 to still accept
+ * connections for configuration and GATT access.
+ */
+#define GAP_BROADCAST_CONNECTABLE 1
+/* Notification period the link policy assumes until told otherwise */
+#define GAP_DEFAULT_NOTIFY_PERIOD_MS 2000
+
+/* Link layer packet size requested for bulk transfers */
+#define GAP_BULK_TX_OCTETS 251
+#define GAP_BULK_TX_TIME_US 2120
+
+/* Bluetooth SIG company id reserved for testing, replace with an assigned one */
+#define GAP_ADV_COMPANY_ID 0xFFFF
+
 /* Public function declarations */
 void adv_init(void);
+void gap_update_adv_reading(const sample_t *sample);
+void gap_set_notify_period(uint32_t period_ms);
+void gap_set_bulk_transfer(uint16_t conn_handle, bool active);
 int gap_init(void);
 
 #endif // GAP_SVC_H
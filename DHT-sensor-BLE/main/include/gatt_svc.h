@@ -14,10 +14,16 @@
 /* NimBLE GAP APIs */
 #include "host/ble_gap.h"
 
+/* Sample types */
+#include "sample_history.h"
+
 /* Public function declarations */
-void send_temperature_humidity_notification(float temperature, float humidity);
+void send_temperature_humidity_notification(const sample_t* sample);
 void gatt_svr_register_cb(struct ble_gatt_register_ctxt* ctxt, void* arg);
 void gatt_svr_subscribe_cb(struct ble_gap_event* event);
+void gatt_svr_notify_tx_cb(struct ble_gap_event* event);
+void gatt_svr_connect_cb(uint16_t conn_handle);
+void gatt_svr_disconnect_cb(uint16_t conn_handle);
 int gatt_svc_init(void);
 
 #endif  // GATT_SVR_H
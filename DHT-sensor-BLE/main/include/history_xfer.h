@@ -0,0 +1,72 @@
+#ifndef HISTORY_XFER_H
+#define HISTORY_XFER_H
+
+/*
+ * Bulk download of the flash sample log over GATT notifications.
+ *
+ * A transfer streams the raw log chunks from a start timestamp as one byte
+ * stream, cut into notifications that fill the negotiated ATT MTU. Every
+ * chunk starts with its own header, so the client splits the stream back
+ * into chunks without extra framing. Each notification is
+ *   uint8  frame type
+ *   uint16 frame sequence, little endian
+ *   data
+ * DATA frames carry stream bytes, the END frame carries the transfer
+ * report (history_xfer_report_t, packed little endian), which still fits
+ * the default 23 byte MTU.
+ *
+ * Notifications are sent in bursts from the NimBLE host task. When the
+ * host runs out of mbufs the frame is kept and retried a little later,
+ * which paces the stream to what the link actually drains. While a
+ * transfer runs the connection is switched to bulk parameters.
+ *
+ * Before the first frame the samples still in RAM have to reach flash.
+ * That write may erase a sector, so the measurement task does it
+ * (sampler_request_flush) and the stream starts once it reports back.
+ *
+ * All functions except history_xfer_log_flushed must be called from the
+ * NimBLE host task.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+#define HISTORY_XFER_FRAME_DATA 0x01
+#define HISTORY_XFER_FRAME_END 0x02
+#define HISTORY_XFER_FRAME_HEADER_SIZE 3
+#define HISTORY_XFER_REPORT_SIZE 17
+
+/* Control point opcodes written by the client */
+#define HISTORY_XFER_OP_ABORT 0x00
+#define HISTORY_XFER_OP_START 0x01
+
+typedef enum {
+    HISTORY_XFER_DONE = 0,
+    HISTORY_XFER_ABORTED,
+    HISTORY_XFER_FAILED,
+} history_xfer_status_t;
+
+/* Result of the last finished transfer */
+typedef struct {
+    uint8_t status;
+    uint32_t bytes;
+    uint32_t chunks;
+    uint32_t duration_ms;
+    uint32_t bytes_per_sec;
+} history_xfer_report_t;
+
+/* Public function declarations */
+void history_xfer_init(void);
+int history_xfer_start(uint16_t conn_handle, uint16_t val_handle, uint32_t from_timestamp);
+void history_xfer_abort(uint16_t conn_handle);
+bool history_xfer_active(uint16_t conn_handle);
+void history_xfer_last_report(history_xfer_report_t* report);
+size_t history_xfer_encode_report(const history_xfer_report_t* report, uint8_t* buf);
+/* Measurement task: the flush a start asked for is done */
+void history_xfer_log_flushed(void);
+
+#endif  // HISTORY_XFER_H
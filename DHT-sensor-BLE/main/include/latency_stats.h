@@ -0,0 +1,71 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+/*
+ * Sensor to notification latency.
+ *
+ * The measurement task marks each stage of a sample with esp_timer time,
+ * the host task reports every notification the stack has handed to the
+ * controller. Stage durations go into fixed histograms with four buckets
+ * per power of two (~19 % resolution, 1 us to ~33 s), cheap enough to
+ * stay enabled in release builds.
+ *
+ *   READ    read start    -> read done      sensor transaction
+ *   FORMAT  read done     -> formatted      conversion and console print
+ *   PUBLISH formatted     -> notify queued  history, flash log, triggers
+ *   TX      notify queued -> NOTIFY_TX      first notification of the sample
+ *   TOTAL   read start    -> NOTIFY_TX      first notification of the sample
+ *
+ * A sample is queued when the stack accepts its first notification, so
+ * samples nobody is subscribed to only count towards READ and FORMAT.
+ * Only the first TX completion after that is recorded; one that arrives
+ * after the next read has started is not counted.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+#define LATENCY_SUB_BUCKETS 4
+#define LATENCY_BUCKETS 96
+
+typedef enum {
+    LATENCY_MARK_READ_START = 0,
+    LATENCY_MARK_READ_DONE,
+    LATENCY_MARK_FORMATTED,
+    LATENCY_MARK_QUEUED,
+    LATENCY_MARK_COUNT,
+} latency_mark_t;
+
+typedef enum {
+    LATENCY_STAGE_READ = 0,
+    LATENCY_STAGE_FORMAT,
+    LATENCY_STAGE_PUBLISH,
+    LATENCY_STAGE_TX,
+    LATENCY_STAGE_TOTAL,
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+/* Summary of one stage, microseconds */
+typedef struct {
+    uint32_t count;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} latency_summary_t;
+
+/* Packed size of one stage on the diagnostics characteristic */
+#define LATENCY_SUMMARY_SIZE 20
+
+/* Public function declarations */
+void latency_mark(latency_mark_t mark);
+void latency_tx_done(void);
+void latency_get_summary(latency_stage_t stage, latency_summary_t* summary);
+size_t latency_encode(uint8_t* buf, size_t size);
+void latency_reset(void);
+void latency_dump(void);
+
+#endif  // LATENCY_STATS_H
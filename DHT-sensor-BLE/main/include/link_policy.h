@@ -0,0 +1,100 @@
+#ifndef LINK_POLICY_H
+#define LINK_POLICY_H
+
+/*
+ * Advertising and connection parameter policy.
+ *
+ * A pure state machine: GAP events go in, the advertising or connection
+ * parameters to apply come out. It does not call NimBLE itself, so it can
+ * be built and exercised on a host.
+ *
+ *   boot / disconnect -> fast advertising for LINK_FAST_ADV_DURATION_MS
+ *   fast adv timeout  -> slow advertising forever
+ *   connect           -> request a connection interval and slave latency
+ *                        that wake the radio about once per notification,
+ *                        and slow advertising while slots are free
+ *   conn update       -> re-request if the central picked something far
+ *                        off, up to LINK_MAX_UPDATE_ATTEMPTS times
+ *   bulk begin / end  -> shortest interval without latency while a
+ *                        history download runs, then back to the above
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+/* Advertising intervals, ms */
+#define LINK_FAST_ADV_ITVL_MIN_MS 30
+#define LINK_FAST_ADV_ITVL_MAX_MS 60
+#define LINK_FAST_ADV_DURATION_MS 30000
+#define LINK_SLOW_ADV_ITVL_MIN_MS 1000
+#define LINK_SLOW_ADV_ITVL_MAX_MS 1100
+
+/* Connection parameter bounds, ms */
+#define LINK_CONN_ITVL_MIN_MS 50
+#define LINK_CONN_ITVL_MAX_MS 150
+#define LINK_MAX_LATENCY 30
+#define LINK_MAX_SUPERVISION_TIMEOUT_MS 32000
+#define LINK_MAX_UPDATE_ATTEMPTS 2
+
+/* Connection parameters during a bulk transfer, ms */
+#define LINK_BULK_ITVL_MAX_MS 15
+#define LINK_BULK_SUPERVISION_TIMEOUT_MS 2000
+
+#define LINK_DURATION_FOREVER (-1)
+
+typedef enum {
+    LINK_EVT_BOOT = 0,
+    LINK_EVT_DISCONNECT,
+    LINK_EVT_ADV_TIMEOUT,
+    LINK_EVT_CONNECT,
+    LINK_EVT_CONN_UPDATE,
+    LINK_EVT_NOTIFY_PERIOD,
+    LINK_EVT_BULK_BEGIN,
+    LINK_EVT_BULK_END,
+} link_event_type_t;
+
+typedef enum {
+    LINK_ADV_FAST = 0,
+    LINK_ADV_SLOW,
+} link_adv_mode_t;
+
+/* Connection parameters in controller units */
+typedef struct {
+    uint16_t itvl_min;            /* 1.25 ms */
+    uint16_t itvl_max;            /* 1.25 ms */
+    uint16_t latency;             /* connection events */
+    uint16_t supervision_timeout; /* 10 ms */
+} link_conn_params_t;
+
+typedef struct {
+    link_event_type_t type;
+    link_conn_params_t current; /* CONNECT / CONN_UPDATE: negotiated values */
+    uint8_t update_attempts;    /* CONN_UPDATE: requests already sent */
+    bool bulk;                  /* CONN_UPDATE: connection is in a bulk transfer */
+    bool slots_free;            /* CONNECT: another central can still connect */
+    uint32_t notify_period_ms;  /* NOTIFY_PERIOD: new sample period */
+} link_event_t;
+
+typedef struct {
+    bool start_adv;
+    uint16_t adv_itvl_min; /* 0.625 ms */
+    uint16_t adv_itvl_max; /* 0.625 ms */
+    int32_t adv_duration_ms;
+    bool update_conn;
+    link_conn_params_t conn;
+} link_action_t;
+
+typedef struct {
+    link_adv_mode_t adv_mode;
+    uint32_t notify_period_ms;
+} link_policy_t;
+
+/* Public function declarations */
+void link_policy_init(link_policy_t* policy, uint32_t notify_period_ms);
+void link_policy_handle(link_policy_t* policy, const link_event_t* event, link_action_t* action);
+void link_policy_conn_params(const link_policy_t* policy, link_conn_params_t* params);
+
+#endif  // LINK_POLICY_H
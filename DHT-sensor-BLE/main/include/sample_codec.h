@@ -0,0 +1,71 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+/*
+ * Streaming bit-packed codec for samples, Gorilla style.
+ *
+ * Per sample, most significant bit first:
+ *   timestamp    delta of delta against the previous sample
+ *                  0                      same spacing
+ *                  10   + 7 bit zigzag
+ *                  110  + 12 bit zigzag
+ *                  1110 + 20 bit zigzag
+ *                  1111 + 32 bit zigzag
+ *   temperature  delta against the previous sample, then humidity
+ *                  0                      unchanged
+ *                  10   + 3 bit zigzag    -4 .. 3
+ *                  110  + 7 bit zigzag    -64 .. 63
+ *                  111  + 16 bit raw value
+ *
+ * A sample costs 3 bits when nothing changed and about 10 to 16 bits
+ * with typical DHT noise of a tenth or two per reading. The encoder
+ * writes into a caller supplied buffer and never allocates. A block is
+ * decoded with the same base timestamp and the sample count, since the
+ * last byte is zero padded.
+ *
+ * Pure C without ESP-IDF dependencies, so it also builds on a host.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sample types */
+#include "sample_history.h"
+
+typedef struct {
+    uint32_t timestamp;
+    int32_t interval;
+    int16_t temperature;
+    uint16_t humidity;
+} sample_codec_state_t;
+
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t bits;
+    uint16_t count;
+    sample_codec_state_t prev;
+} sample_encoder_t;
+
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    size_t bits;
+    uint16_t left;
+    sample_codec_state_t prev;
+} sample_decoder_t;
+
+/* Public function declarations */
+void sample_encoder_init(sample_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t base_timestamp);
+/* Append a sample; false, with the encoder unchanged, if it does not fit */
+bool sample_encoder_put(sample_encoder_t* enc, const sample_t* sample);
+size_t sample_encoder_bytes(const sample_encoder_t* enc);
+
+void sample_decoder_init(sample_decoder_t* dec, const uint8_t* buf, size_t len, uint32_t base_timestamp, uint16_t count);
+/* Next sample, false at the end of the block or on truncated input */
+bool sample_decoder_next(sample_decoder_t* dec, sample_t* sample);
+
+#endif  // SAMPLE_CODEC_H
@@ -0,0 +1,54 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+/* Includes */
+/* STD APIs */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+/* Number of samples kept in RAM, ~17 min at one sample every 2 s */
+#define SAMPLE_HISTORY_LEN 512
+
+/* Rolling aggregate windows */
+#define SAMPLE_WINDOW_BUCKETS 60
+#define SAMPLE_WINDOW_SHORT_SECS 60
+#define SAMPLE_WINDOW_LONG_SECS 3600
+
+typedef enum {
+    SAMPLE_WINDOW_SHORT = 0,
+    SAMPLE_WINDOW_LONG,
+    SAMPLE_WINDOW_COUNT,
+} sample_window_id_t;
+
+/* One measurement, fixed point */
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;  /* seconds */
+    int16_t temperature; /* 0.1 °C */
+    uint16_t humidity;   /* 0.1 %RH */
+} sample_t;
+
+/* Aggregate over one window, kept up to date on every push and read */
+typedef struct {
+    uint16_t count;
+    int16_t temperature_min;
+    int16_t temperature_max;
+    int16_t temperature_mean;
+    uint16_t humidity_min;
+    uint16_t humidity_max;
+    uint16_t humidity_mean;
+} sample_agg_t;
+
+/* Public function declarations */
+void sample_history_init(void);
+/* Sample clock in seconds; timestamps continue from base so they stay monotonic across reboots */
+void sample_history_set_time_base(uint32_t base);
+uint32_t sample_history_now(void);
+uint32_t sample_history_push(uint32_t timestamp, int16_t temperature, uint16_t humidity);
+/* Aggregate over the window ending at now */
+void sample_history_get_agg(sample_window_id_t window, uint32_t now, sample_agg_t* agg);
+size_t sample_history_read_since(uint32_t seq, sample_t* out, size_t max);
+uint32_t sample_history_next_seq(void);
+
+#endif  // SAMPLE_HISTORY_H
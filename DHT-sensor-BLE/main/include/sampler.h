@@ -0,0 +1,57 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/*
+ * Demand driven sample acquisition.
+ *
+ * The measurement task reads the sensor every SAMPLER_PERIOD_MS while
+ * background sampling is on, since the advertising data and the flash log
+ * want every sample whether or not anybody is connected. GATT clients only
+ * add demand on top of that:
+ *   - periodically while any connection is subscribed to a sample
+ *     notification (temperature, humidity, record or ESS)
+ *   - on a GATT read whose cached sample is older than SAMPLER_TTL_MS
+ * With background sampling off, nobody subscribed and nobody reading, the
+ * task stays blocked and the sensor is left alone.
+ *
+ * Reads never come closer than SAMPLER_MIN_INTERVAL_MS, the sensor's own
+ * limit. A GATT read is always answered from the cache: a stale one only
+ * kicks off a new sample for the reads after it, since the NimBLE host task
+ * must not block inside an access callback.
+ *
+ * The same task also writes out the log chunk still held in RAM when
+ * another task asks for it, since that write may erase a flash sector
+ * and must not stall the NimBLE host task.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdbool.h>
+
+/* Defines */
+#define SAMPLER_PERIOD_MS 2000
+#define SAMPLER_MIN_INTERVAL_MS 2000
+#define SAMPLER_TTL_MS 10000
+
+/* Work handed to the measurement task */
+typedef enum {
+    SAMPLER_JOB_READ = 0,
+    SAMPLER_JOB_FLUSH_LOG,
+} sampler_job_t;
+
+/* Public function declarations */
+void sampler_init(void);
+/* Measurement task: block until the next read or log flush is due */
+sampler_job_t sampler_wait(void);
+/* Measurement task: the read is done and, if ok, published */
+void sampler_done(bool ok);
+/* Any task: start or stop periodic sampling for notification subscribers */
+void sampler_set_periodic(bool periodic);
+/* Any task: start or stop periodic sampling for the advertising data and the log */
+void sampler_set_background(bool background);
+/* Host task, before serving a sample read from the cache: have a stale one refreshed, never waits */
+void sampler_refresh(void);
+/* Any task: have the measurement task flush the sample log */
+void sampler_request_flush(void);
+
+#endif  // SAMPLER_H
@@ -7,10 +7,19 @@
 #include <dht.h>
 
 #include "common.h"
+#include "dlog.h"
+#include "duty_cycle.h"
 #include "gap.h"
 #include "gatt_svc.h"
+#include "history_xfer.h"
+#include "latency_stats.h"
+#include "sample_history.h"
+#include "sampler.h"
+#include "sensor_log.h"
 #define SENSOR_TYPE DHT_TYPE_AM2301
 #define SENSOR_GPIO 4
+/* Latency histograms are printed every this many samples */
+#define LATENCY_DUMP_EVERY 30
 
 /* Library function declarations */
 void ble_store_config_init(void);
@@ -60,16 +69,45 @@ static void nimble_host_task(void* param) {
 }
 
 void dht_measure_task(void* pvParameters) {
-    float temperature, humidity;
+    /* Tenths straight from the sensor frame, no float anywhere on the path */
+    int16_t temperature, humidity;
+    uint32_t samples = 0;
 
     while (1) {
-        if (dht_read_float_data(SENSOR_TYPE, SENSOR_GPIO, &humidity, &temperature) == ESP_OK) {
-            printf("Humidity: %.1f%% Temp: %.1fC\n", humidity, temperature);
-            send_temperature_humidity_notification(temperature, humidity);
+        /* Blocks until the sampling period, a stale GATT read or a download asks for a sample or a flush */
+        if (sampler_wait() == SAMPLER_JOB_FLUSH_LOG) {
+            /* A history download wants the samples still in RAM; the write may erase a sector */
+            duty_cycle_window_begin();
+            sensor_log_flush();
+            history_xfer_log_flushed();
+            duty_cycle_window_end();
+            continue;
+        }
+        duty_cycle_window_begin();
+        duty_cycle_set_state(ENERGY_STATE_SENSOR);
+        latency_mark(LATENCY_MARK_READ_START);
+        bool ok = dht_read_data(SENSOR_TYPE, SENSOR_GPIO, &humidity, &temperature) == ESP_OK;
+        duty_cycle_set_state(ENERGY_STATE_ACTIVE);
+        if (ok) {
+            latency_mark(LATENCY_MARK_READ_DONE);
+            sample_t sample = {.timestamp = sample_history_now(),
+                               .temperature = temperature,
+                               .humidity = (uint16_t)humidity};
+            latency_mark(LATENCY_MARK_FORMATTED);
+            DLOG(TAG, "sample: humidity=%u temperature=%d (tenths)", sample.humidity, sample.temperature);
+            sample.seq = sample_history_push(sample.timestamp, sample.temperature, sample.humidity);
+            sensor_log_append(&sample);
+            send_temperature_humidity_notification(&sample);
+            gap_update_adv_reading(&sample);
+            if (++samples % LATENCY_DUMP_EVERY == 0) {
+                latency_dump();
+                duty_cycle_dump();
+            }
         } else {
-            printf("Could not read data from sensor\n");
+            DLOG(TAG, "could not read data from sensor");
         }
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        sampler_done(ok);
+        duty_cycle_window_end();
     }
 }
 
@@ -78,6 +116,14 @@ void app_main(void) {
     int rc;
     esp_err_t ret;
 
+    /* Deferred log drain, below every task that logs through it */
+    if (dlog_start(1) != 0) {
+        ESP_LOGE(TAG, "failed to start deferred log task");
+    }
+
+    /* Light sleep between wake windows */
+    duty_cycle_init();
+
     /*
      * NVS flash initialization
      * Dependency of BLE stack to store configurations
@@ -113,11 +159,25 @@ void app_main(void) {
         return;
     }
 
+    /* Sample history initialization */
+    sample_history_init();
+    sampler_init();
+
+    /* Flash sample log initialization */
+    ret = sensor_log_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "failed to initialize sensor log, error code: %d", ret);
+    }
+    sample_history_set_time_base(sensor_log_last_timestamp() + 1);
+
+    /* The advertising data always carries the latest reading, and the log keeps every sample */
+    sampler_set_background(true);
+
     /* NimBLE host configuration initialization */
     nimble_host_config_init();
 
     /* Start NimBLE host task thread and return */
     xTaskCreate(nimble_host_task, "NimBLE Host", 4 * 1024, NULL, 5, NULL);
-    xTaskCreate(dht_measure_task, "dht_measure", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+    xTaskCreate(dht_measure_task, "dht_measure", 4 * 1024, NULL, 5, NULL);
     return;
 }
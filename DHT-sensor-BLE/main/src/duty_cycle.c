@@ -0,0 +1,135 @@
+/* Includes */
+#include "duty_cycle.h"
+
+#include <stdbool.h>
+
+/* ESP APIs */
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+
+/* Shared components */
+#include "dlog.h"
+
+/* Defines */
+#define LOG_TAG "DutyCycle"
+#define PERIOD_US ((int64_t)DUTY_CYCLE_PERIOD_MS * 1000)
+
+/* Private variables */
+static const energy_profile_t profile = ENERGY_PROFILE_DEFAULT;
+static energy_ledger_t ledger;
+static energy_state_t rest_state = ENERGY_STATE_IDLE;
+static portMUX_TYPE ledger_lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t window_lock = NULL;
+#endif
+
+/* Private functions */
+static void enter(energy_state_t state) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&ledger_lock);
+    energy_ledger_enter(&ledger, state, now);
+    portEXIT_CRITICAL(&ledger_lock);
+}
+
+/* Public functions */
+void duty_cycle_init(void) {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "wake_window", &window_lock);
+    }
+    if (err == ESP_OK) {
+        rest_state = ENERGY_STATE_SLEEP;
+    } else {
+        ESP_LOGE(LOG_TAG, "light sleep not available, error code: %d", err);
+    }
+#else
+    ESP_LOGI(LOG_TAG, "power management disabled, idling between windows");
+#endif
+
+    energy_ledger_init(&ledger, rest_state, esp_timer_get_time());
+
+    /*
+     * The deferred log is drained at the start of each window, for lines the
+     * host task and transfers queued since the last one, and at its end for
+     * the window's own. A burst in between wakes the drain task at the
+     * ring's high-water mark; the period is only a fallback.
+     */
+    dlog_set_drain_period(DUTY_CYCLE_LOG_DRAIN_MS);
+}
+
+int64_t duty_cycle_align_us(int64_t time_us) {
+    return (time_us + PERIOD_US - 1) / PERIOD_US * PERIOD_US;
+}
+
+void duty_cycle_window_begin(void) {
+#if CONFIG_PM_ENABLE
+    if (window_lock != NULL) {
+        esp_pm_lock_acquire(window_lock);
+    }
+#endif
+    enter(ENERGY_STATE_ACTIVE);
+    dlog_flush();
+}
+
+void duty_cycle_set_state(energy_state_t state) {
+    enter(state);
+}
+
+void duty_cycle_window_end(void) {
+    dlog_flush();
+    enter(rest_state);
+#if CONFIG_PM_ENABLE
+    if (window_lock != NULL) {
+        esp_pm_lock_release(window_lock);
+    }
+#endif
+}
+
+void duty_cycle_radio_period(energy_event_t event, uint32_t period_us) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&ledger_lock);
+    energy_ledger_set_period(&ledger, event, period_us, now);
+    portEXIT_CRITICAL(&ledger_lock);
+}
+
+void duty_cycle_radio_event(energy_event_t event) {
+    portENTER_CRITICAL(&ledger_lock);
+    energy_ledger_count(&ledger, event, 1);
+    portEXIT_CRITICAL(&ledger_lock);
+}
+
+void duty_cycle_dump(void) {
+    static const char* const state_names[ENERGY_STATE_COUNT] = {"sleep", "idle", "active", "sensor"};
+    energy_ledger_t copy;
+    energy_state_t state;
+    int64_t now = esp_timer_get_time();
+
+    /* Book the running state without switching it */
+    portENTER_CRITICAL(&ledger_lock);
+    state = ledger.state;
+    energy_ledger_enter(&ledger, state, now);
+    copy = ledger;
+    portEXIT_CRITICAL(&ledger_lock);
+
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        ESP_LOGI(LOG_TAG, "%-6s %llu ms", state_names[s], (unsigned long long)(copy.state_us[s] / 1000));
+    }
+    ESP_LOGI(LOG_TAG, "adv=%lu conn=%lu notify=%lu events", (unsigned long)copy.events[ENERGY_EVENT_ADV],
+             (unsigned long)copy.events[ENERGY_EVENT_CONN], (unsigned long)copy.events[ENERGY_EVENT_NOTIFY]);
+    ESP_LOGI(LOG_TAG, "avg %lu uA, ~%lu h on %d mAh", (unsigned long)energy_ledger_avg_ua(&copy, &profile),
+             (unsigned long)energy_ledger_battery_hours(&copy, &profile, DUTY_CYCLE_BATTERY_MAH), DUTY_CYCLE_BATTERY_MAH);
+}
@@ -0,0 +1,117 @@
+/* Includes */
+#include "energy_ledger.h"
+
+#include <string.h>
+
+/* Private functions */
+/* Book time up to now; periodic radio sources accrue with it */
+static void settle(energy_ledger_t* ledger, int64_t now_us) {
+    uint64_t dt = now_us > ledger->since_us ? (uint64_t)(now_us - ledger->since_us) : 0;
+
+    ledger->state_us[ledger->state] += dt;
+    for (int e = 0; e < ENERGY_EVENT_COUNT; e++) {
+        uint64_t accrued;
+
+        if (ledger->period_us[e] == 0) {
+            continue;
+        }
+        accrued = ledger->accrued_us[e] + dt;
+        ledger->events[e] += (uint32_t)(accrued / ledger->period_us[e]);
+        ledger->accrued_us[e] = (uint32_t)(accrued % ledger->period_us[e]);
+    }
+    ledger->since_us = now_us;
+}
+
+/* Public functions */
+void energy_ledger_init(energy_ledger_t* ledger, energy_state_t state, int64_t now_us) {
+    memset(ledger, 0, sizeof(*ledger));
+    ledger->state = state;
+    ledger->since_us = now_us;
+}
+
+void energy_ledger_enter(energy_ledger_t* ledger, energy_state_t state, int64_t now_us) {
+    settle(ledger, now_us);
+    ledger->state = state;
+}
+
+void energy_ledger_count(energy_ledger_t* ledger, energy_event_t event, uint32_t count) {
+    ledger->events[event] += count;
+}
+
+void energy_ledger_set_period(energy_ledger_t* ledger, energy_event_t event, uint32_t period_us, int64_t now_us) {
+    settle(ledger, now_us);
+    if (ledger->period_us[event] != period_us) {
+        ledger->period_us[event] = period_us;
+        ledger->accrued_us[event] = 0;
+    }
+}
+
+uint64_t energy_ledger_elapsed_us(const energy_ledger_t* ledger) {
+    uint64_t total = 0;
+
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        total += ledger->state_us[s];
+    }
+    return total;
+}
+
+uint64_t energy_ledger_charge_uc(const energy_ledger_t* ledger, const energy_profile_t* profile) {
+    uint64_t pc = 0; /* us x uA */
+
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        pc += ledger->state_us[s] * profile->state_ua[s];
+    }
+    for (int e = 0; e < ENERGY_EVENT_COUNT; e++) {
+        pc += (uint64_t)ledger->events[e] * profile->event_uc[e] * 1000000;
+    }
+    return pc / 1000000;
+}
+
+uint32_t energy_ledger_avg_ua(const energy_ledger_t* ledger, const energy_profile_t* profile) {
+    uint64_t elapsed = energy_ledger_elapsed_us(ledger);
+
+    if (elapsed == 0) {
+        return 0;
+    }
+    return (uint32_t)(energy_ledger_charge_uc(ledger, profile) * 1000000 / elapsed);
+}
+
+uint32_t energy_ledger_battery_hours(const energy_ledger_t* ledger, const energy_profile_t* profile, uint32_t capacity_mah) {
+    uint32_t avg_ua = energy_ledger_avg_ua(ledger, profile);
+
+    if (avg_ua == 0) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)((uint64_t)capacity_mah * 1000 / avg_ua);
+}
+
+/*
+ * One wake window per sample period: sensor read, publish with one
+ * notification when connected, then sleep or idle until the next window.
+ * Radio events run from their own intervals in the background.
+ */
+void energy_simulate(const energy_scenario_t* scenario, energy_ledger_t* ledger) {
+    int64_t end_us = (int64_t)scenario->duration_s * 1000000;
+    int64_t period_us = (int64_t)scenario->sample_period_ms * 1000;
+    energy_state_t rest = scenario->light_sleep ? ENERGY_STATE_SLEEP : ENERGY_STATE_IDLE;
+    int64_t t = 0;
+
+    energy_ledger_init(ledger, rest, 0);
+    energy_ledger_set_period(ledger, ENERGY_EVENT_ADV, scenario->adv_itvl_ms * 1000, 0);
+    energy_ledger_set_period(ledger, ENERGY_EVENT_CONN, scenario->conn_event_ms * 1000, 0);
+
+    while (period_us > 0 && t < end_us) {
+        int64_t read_end = t + (int64_t)scenario->sensor_read_ms * 1000;
+        int64_t publish_end = read_end + (int64_t)scenario->publish_ms * 1000;
+        int64_t next = t + period_us;
+
+        energy_ledger_enter(ledger, ENERGY_STATE_SENSOR, t);
+        energy_ledger_enter(ledger, ENERGY_STATE_ACTIVE, read_end < end_us ? read_end : end_us);
+        if (scenario->conn_event_ms != 0) {
+            energy_ledger_count(ledger, ENERGY_EVENT_NOTIFY, 1);
+        }
+        energy_ledger_enter(ledger, rest, publish_end < end_us ? publish_end : end_us);
+        t = next;
+    }
+    energy_ledger_enter(ledger, rest, end_us);
+}
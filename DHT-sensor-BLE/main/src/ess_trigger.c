@@ -0,0 +1,143 @@
+/* Includes */
+#include "ess_trigger.h"
+
+#include <string.h>
+
+/* Private functions */
+static bool is_time_condition(uint8_t condition) {
+    return condition == ESS_TRIGGER_FIXED_INTERVAL || condition == ESS_TRIGGER_MIN_INTERVAL;
+}
+
+static bool compare(uint8_t condition, int32_t value, int32_t operand) {
+    switch (condition) {
+        case ESS_TRIGGER_LESS_THAN:
+            return value < operand;
+        case ESS_TRIGGER_LESS_OR_EQUAL:
+            return value <= operand;
+        case ESS_TRIGGER_GREATER_THAN:
+            return value > operand;
+        case ESS_TRIGGER_GREATER_OR_EQUAL:
+            return value >= operand;
+        case ESS_TRIGGER_EQUAL:
+            return value == operand;
+        case ESS_TRIGGER_NOT_EQUAL:
+            return value != operand;
+        default:
+            return false;
+    }
+}
+
+static void mark_sent(ess_trigger_t* trigger, int32_t value, uint32_t now) {
+    trigger->has_last = true;
+    trigger->last_value = value;
+    trigger->last_time = now;
+}
+
+/* Public functions */
+void ess_trigger_init(ess_trigger_t* trigger, uint8_t condition, int32_t operand) {
+    memset(trigger, 0, sizeof(*trigger));
+    trigger->condition = condition;
+    trigger->operand = operand;
+    trigger->has_operand = is_time_condition(condition) || operand != 0;
+}
+
+/*
+ * Parse a written ES Trigger Setting value. Time operands are uint24,
+ * value operands use the 16-bit format of the characteristic.
+ * Returns 0 on success, -1 if the value is malformed.
+ */
+int ess_trigger_parse(ess_trigger_t* trigger, const uint8_t* buf, size_t len, bool value_signed) {
+    if (len < 1) {
+        return -1;
+    }
+
+    uint8_t condition = buf[0];
+    int32_t operand = 0;
+    bool has_operand = false;
+
+    if (condition == ESS_TRIGGER_INACTIVE) {
+        if (len != 1) {
+            return -1;
+        }
+    } else if (is_time_condition(condition)) {
+        if (len != 4) {
+            return -1;
+        }
+        operand = (int32_t)((uint32_t)buf[1] | ((uint32_t)buf[2] << 8) | ((uint32_t)buf[3] << 16));
+        has_operand = true;
+    } else if (condition <= ESS_TRIGGER_NOT_EQUAL) {
+        if (len == 3) {
+            uint16_t raw = (uint16_t)(buf[1] | (buf[2] << 8));
+            operand = value_signed ? (int16_t)raw : raw;
+            has_operand = true;
+        } else if (!(condition == ESS_TRIGGER_VALUE_CHANGED && len == 1)) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+
+    memset(trigger, 0, sizeof(*trigger));
+    trigger->condition = condition;
+    trigger->operand = operand;
+    trigger->has_operand = has_operand;
+    return 0;
+}
+
+size_t ess_trigger_encode(const ess_trigger_t* trigger, uint8_t* buf) {
+    buf[0] = trigger->condition;
+    if (!trigger->has_operand) {
+        return 1;
+    }
+    buf[1] = (uint8_t)trigger->operand;
+    buf[2] = (uint8_t)(trigger->operand >> 8);
+    if (is_time_condition(trigger->condition)) {
+        buf[3] = (uint8_t)(trigger->operand >> 16);
+        return 4;
+    }
+    return 3;
+}
+
+/*
+ * Decide whether a new value should be notified. Updates the trigger
+ * state, so it must be called exactly once per sample and connection.
+ */
+bool ess_trigger_evaluate(ess_trigger_t* trigger, int32_t value, uint32_t now) {
+    bool notify = false;
+    int32_t delta = trigger->has_last ? value - trigger->last_value : 0;
+    int32_t deadband = trigger->has_operand && trigger->operand > 0 ? trigger->operand : 1;
+
+    if (delta < 0) {
+        delta = -delta;
+    }
+
+    switch (trigger->condition) {
+        case ESS_TRIGGER_INACTIVE:
+            return false;
+
+        case ESS_TRIGGER_FIXED_INTERVAL:
+            notify = !trigger->has_last || now - trigger->last_time >= (uint32_t)trigger->operand;
+            break;
+
+        case ESS_TRIGGER_MIN_INTERVAL:
+            notify = !trigger->has_last || (delta != 0 && now - trigger->last_time >= (uint32_t)trigger->operand);
+            break;
+
+        case ESS_TRIGGER_VALUE_CHANGED:
+            notify = !trigger->has_last || delta >= deadband;
+            break;
+
+        default: {
+            /* Notify on the edge into the condition */
+            bool match = compare(trigger->condition, value, trigger->operand);
+            notify = match && !trigger->last_match;
+            trigger->last_match = match;
+            break;
+        }
+    }
+
+    if (notify) {
+        mark_sent(trigger, value, now);
+    }
+    return notify;
+}
@@ -6,18 +6,50 @@
 /* Includes */
 #include "gap.h"
 #include "common.h"
+#include "duty_cycle.h"
 #include "gatt_svc.h"
+#include "link_policy.h"
 
 /* Private function declarations */
 inline static void format_addr(char *addr_str, uint8_t addr[]);
+static void account_conn_events(const struct ble_gap_conn_desc *desc);
 static void print_conn_desc(struct ble_gap_conn_desc *desc);
+static int set_adv_data(void);
 static void start_advertising(void);
+static void resume_advertising(void);
+static void apply_link_event(const link_event_t *event, uint16_t conn_handle);
 static int gap_event_handler(struct ble_gap_event *event, void *arg);
 
 /* Private variables */
 static uint8_t own_addr_type;
 static uint8_t addr_val[6] = {0};
-static uint8_t esp_uri[] = {BLE_GAP_URI_PREFIX_HTTPS, '/', '/', 'e', 's', 'p', 'r', 'e', 's', 's', 'i', 'f', '.', 'c', 'o', 'm'};
+static int active_connections = 0;
+
+/* Advertising / connection parameter policy and its current output */
+static link_policy_t link_policy;
+static uint16_t adv_itvl_min = BLE_GAP_ADV_ITVL_MS(500);
+static uint16_t adv_itvl_max = BLE_GAP_ADV_ITVL_MS(510);
+static int32_t adv_duration_ms = BLE_HS_FOREVER;
+
+/* Connection parameter update requests sent per connection */
+typedef struct {
+    uint16_t conn_handle;
+    bool in_use;
+    uint8_t update_attempts;
+    bool bulk;
+} conn_link_t;
+static conn_link_t conn_links[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+
+/*
+ * Latest reading in manufacturer specific data, little endian
+ *   uint16 company id, uint8 format version, uint16 sequence,
+ *   int16 temperature 0.1 °C, uint16 humidity 0.1 %RH
+ */
+#define ADV_READING_LEN 9
+#define ADV_READING_VERSION 0x01
+static uint8_t adv_reading[ADV_READING_LEN];
+static bool adv_reading_valid = false;
+static portMUX_TYPE adv_reading_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /* Private functions */
 inline static void format_addr(char *addr_str, uint8_t addr[]) {
@@ -25,6 +57,16 @@ inline static void format_addr(char *addr_str, uint8_t addr[]) {
             addr[2], addr[3], addr[4], addr[5]);
 }
 
+/*
+ * Radio wakes once per connection interval times (latency + 1) when idle;
+ * with several centrals only the latest link is booked
+ */
+static void account_conn_events(const struct ble_gap_conn_desc *desc) {
+    duty_cycle_radio_period(ENERGY_EVENT_CONN,
+                            (uint32_t)desc->conn_itvl * 1250 *
+                                (desc->conn_latency + 1));
+}
+
 static void print_conn_desc(struct ble_gap_conn_desc *desc) {
     /* Local variables */
     char addr_str[18] = {0};
@@ -51,13 +93,17 @@ static void print_conn_desc(struct ble_gap_conn_desc *desc) {
              desc->sec_state.bonded);
 }
 
-static void start_advertising(void) {
+/*
+ * Advertising data: flags, name, tx power and, once a sample is available,
+ * the latest reading as manufacturer specific data. Called again on every
+ * new sample so passive scanners see fresh values without connecting.
+ */
+static int set_adv_data(void) {
     /* Local variables */
-    int rc = 0;
     const char *name;
+    uint8_t mfg_data[ADV_READING_LEN];
+    bool has_reading;
     struct ble_hs_adv_fields adv_fields = {0};
-    struct ble_hs_adv_fields rsp_fields = {0};
-    struct ble_gap_adv_params adv_params = {0};
 
     /* Set advertising flags */
     adv_fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
@@ -72,16 +118,28 @@ static void start_advertising(void) {
     adv_fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
     adv_fields.tx_pwr_lvl_is_present = 1;
 
-    /* Set device appearance */
-    adv_fields.appearance = BLE_GAP_APPEARANCE_GENERIC_TAG;
-    adv_fields.appearance_is_present = 1;
+    /* Set latest reading */
+    portENTER_CRITICAL(&adv_reading_lock);
+    has_reading = adv_reading_valid;
+    memcpy(mfg_data, adv_reading, sizeof(mfg_data));
+    portEXIT_CRITICAL(&adv_reading_lock);
+    if (has_reading) {
+        adv_fields.mfg_data = mfg_data;
+        adv_fields.mfg_data_len = sizeof(mfg_data);
+    }
 
-    /* Set device LE role */
-    adv_fields.le_role = BLE_GAP_LE_ROLE_PERIPHERAL;
-    adv_fields.le_role_is_present = 1;
+    /* Set advertiement fields */
+    return ble_gap_adv_set_fields(&adv_fields);
+}
+
+static void start_advertising(void) {
+    /* Local variables */
+    int rc = 0;
+    struct ble_hs_adv_fields rsp_fields = {0};
+    struct ble_gap_adv_params adv_params = {0};
 
     /* Set advertiement fields */
-    rc = ble_gap_adv_set_fields(&adv_fields);
+    rc = set_adv_data();
     if (rc != 0) {
         ESP_LOGE(TAG, "failed to set advertising data, error code: %d", rc);
         return;
@@ -92,12 +150,16 @@ static void start_advertising(void) {
     rsp_fields.device_addr_type = own_addr_type;
     rsp_fields.device_addr_is_present = 1;
 
-    /* Set URI */
-    rsp_fields.uri = esp_uri;
-    rsp_fields.uri_len = sizeof(esp_uri);
+    /* Set device appearance */
+    rsp_fields.appearance = BLE_GAP_APPEARANCE_GENERIC_TAG;
+    rsp_fields.appearance_is_present = 1;
+
+    /* Set device LE role */
+    rsp_fields.le_role = BLE_GAP_LE_ROLE_PERIPHERAL;
+    rsp_fields.le_role_is_present = 1;
 
     /* Set advertising interval */
-    rsp_fields.adv_itvl = BLE_GAP_ADV_ITVL_MS(500);
+    rsp_fields.adv_itvl = adv_itvl_min;
     rsp_fields.adv_itvl_is_present = 1;
 
     /* Set scan response fields */
@@ -107,22 +169,86 @@ static void start_advertising(void) {
         return;
     }
 
-    /* Set non-connetable and general discoverable mode to be a beacon */
-    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+    /* Connectable for configuration, or a pure non-connectable broadcaster */
+    adv_params.conn_mode = GAP_BROADCAST_CONNECTABLE ? BLE_GAP_CONN_MODE_UND : BLE_GAP_CONN_MODE_NON;
     adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
 
-    /* Set advertising interval */
-    adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(500);
-    adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(510);
+    /* Set advertising interval chosen by the link policy */
+    adv_params.itvl_min = adv_itvl_min;
+    adv_params.itvl_max = adv_itvl_max;
 
     /* Start advertising */
-    rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params,
+    rc = ble_gap_adv_start(own_addr_type, NULL, adv_duration_ms, &adv_params,
                            gap_event_handler, NULL);
     if (rc != 0) {
         ESP_LOGE(TAG, "failed to start advertising, error code: %d", rc);
         return;
     }
-    ESP_LOGI(TAG, "advertising started!");
+    ESP_LOGI(TAG, "advertising started! itvl=%d-%d duration=%ld", adv_itvl_min,
+             adv_itvl_max, (long)adv_duration_ms);
+    duty_cycle_radio_period(ENERGY_EVENT_ADV, (uint32_t)adv_itvl_min * 625);
+}
+
+/*
+ * Keep advertising while there are free connection slots, so more than
+ * one central can connect at the same time
+ */
+static void resume_advertising(void) {
+    if (active_connections < CONFIG_BT_NIMBLE_MAX_CONNECTIONS && !ble_gap_adv_active()) {
+        start_advertising();
+    }
+}
+
+static conn_link_t *conn_link_find(uint16_t conn_handle) {
+    for (int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        if (conn_links[i].in_use && conn_links[i].conn_handle == conn_handle) {
+            return &conn_links[i];
+        }
+    }
+    return NULL;
+}
+
+/* Feed an event to the link policy and apply what it asks for */
+static void apply_link_event(const link_event_t *event, uint16_t conn_handle) {
+    /* Local variables */
+    int rc;
+    link_action_t action;
+    conn_link_t *link;
+
+    link_policy_handle(&link_policy, event, &action);
+
+    /* New advertising parameters, restart advertising if it is running */
+    if (action.start_adv) {
+        adv_itvl_min = action.adv_itvl_min;
+        adv_itvl_max = action.adv_itvl_max;
+        adv_duration_ms = action.adv_duration_ms == LINK_DURATION_FOREVER
+                              ? BLE_HS_FOREVER
+                              : action.adv_duration_ms;
+        if (ble_gap_adv_active()) {
+            ble_gap_adv_stop();
+        }
+        resume_advertising();
+    }
+
+    /* Request connection parameters matching the notification rate */
+    if (action.update_conn && conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+        struct ble_gap_upd_params params = {
+            .itvl_min = action.conn.itvl_min,
+            .itvl_max = action.conn.itvl_max,
+            .latency = action.conn.latency,
+            .supervision_timeout = action.conn.supervision_timeout};
+        rc = ble_gap_update_params(conn_handle, &params);
+        if (rc != 0) {
+            ESP_LOGE(TAG,
+                     "failed to update connection parameters, error code: %d",
+                     rc);
+            return;
+        }
+        link = conn_link_find(conn_handle);
+        if (link != NULL) {
+            link->update_attempts++;
+        }
+    }
 }
 
 /*
@@ -134,6 +260,8 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
     /* Local variables */
     int rc = 0;
     struct ble_gap_conn_desc desc;
+    link_event_t link_event = {0};
+    conn_link_t *link;
 
     /* Handle different GAP event */
     switch (event->type) {
@@ -159,24 +287,34 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
             /* Print connection descriptor */
             print_conn_desc(&desc);
 
-            /* Try to update connection parameters */
-            struct ble_gap_upd_params params = {.itvl_min = desc.conn_itvl,
-                                                .itvl_max = desc.conn_itvl,
-                                                .latency = 3,
-                                                .supervision_timeout =
-                                                    desc.supervision_timeout};
-            rc = ble_gap_update_params(event->connect.conn_handle, &params);
-            if (rc != 0) {
-                ESP_LOGE(
-                    TAG,
-                    "failed to update connection parameters, error code: %d",
-                    rc);
-                return rc;
+            /* Advertising stopped when the central connected */
+            duty_cycle_radio_period(ENERGY_EVENT_ADV, 0);
+            account_conn_events(&desc);
+
+            /* Track connection */
+            active_connections++;
+            gatt_svr_connect_cb(event->connect.conn_handle);
+            for (int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+                if (!conn_links[i].in_use) {
+                    conn_links[i] = (conn_link_t){
+                        .conn_handle = event->connect.conn_handle,
+                        .in_use = true};
+                    break;
+                }
             }
+
+            /*
+             * Policy picks connection parameters and slow advertising for
+             * further centrals
+             */
+            link_event.type = LINK_EVT_CONNECT;
+            link_event.slots_free =
+                active_connections < CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+            apply_link_event(&link_event, event->connect.conn_handle);
         }
         /* Connection failed, restart advertising */
         else {
-            start_advertising();
+            resume_advertising();
         }
         return rc;
 
@@ -186,8 +324,22 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
         ESP_LOGI(TAG, "disconnected from peer; reason=%d",
                  event->disconnect.reason);
 
-        /* Restart advertising */
-        start_advertising();
+        /* Release connection slot and restart advertising */
+        if (active_connections > 0) {
+            active_connections--;
+        }
+        if (active_connections == 0) {
+            duty_cycle_radio_period(ENERGY_EVENT_CONN, 0);
+        }
+        link = conn_link_find(event->disconnect.conn.conn_handle);
+        if (link != NULL) {
+            link->in_use = false;
+        }
+        gatt_svr_disconnect_cb(event->disconnect.conn.conn_handle);
+
+        /* Fast advertising so the peer can reconnect quickly */
+        link_event.type = LINK_EVT_DISCONNECT;
+        apply_link_event(&link_event, BLE_HS_CONN_HANDLE_NONE);
         return rc;
 
     /* Connection parameters update event */
@@ -204,6 +356,18 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
             return rc;
         }
         print_conn_desc(&desc);
+        account_conn_events(&desc);
+
+        /* Ask again if the central chose something far off */
+        link = conn_link_find(event->conn_update.conn_handle);
+        link_event.type = LINK_EVT_CONN_UPDATE;
+        link_event.current.itvl_min = desc.conn_itvl;
+        link_event.current.itvl_max = desc.conn_itvl;
+        link_event.current.latency = desc.conn_latency;
+        link_event.current.supervision_timeout = desc.supervision_timeout;
+        link_event.update_attempts = link != NULL ? link->update_attempts : LINK_MAX_UPDATE_ATTEMPTS;
+        link_event.bulk = link != NULL && link->bulk;
+        apply_link_event(&link_event, event->conn_update.conn_handle);
         return rc;
 
     /* Advertising complete event */
@@ -211,7 +375,16 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
         /* Advertising completed, restart advertising */
         ESP_LOGI(TAG, "advertise complete; reason=%d",
                  event->adv_complete.reason);
-        start_advertising();
+
+        duty_cycle_radio_period(ENERGY_EVENT_ADV, 0);
+
+        /* Fast advertising window is over, back off to slow advertising */
+        if (event->adv_complete.reason == BLE_HS_ETIMEOUT) {
+            link_event.type = LINK_EVT_ADV_TIMEOUT;
+            apply_link_event(&link_event, BLE_HS_CONN_HANDLE_NONE);
+        } else {
+            resume_advertising();
+        }
         return rc;
 
     /* Notification sent event */
@@ -225,6 +398,13 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
                      event->notify_tx.conn_handle, event->notify_tx.attr_handle,
                      event->notify_tx.status, event->notify_tx.indication);
         }
+
+        if (event->notify_tx.status == 0 && !event->notify_tx.indication) {
+            duty_cycle_radio_event(ENERGY_EVENT_NOTIFY);
+        }
+
+        /* GATT notification sent callback */
+        gatt_svr_notify_tx_cb(event);
         return rc;
 
     /* Subscribe event */
@@ -244,7 +424,10 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
 
     /* MTU update event */
     case BLE_GAP_EVENT_MTU:
-        /* Print MTU update info to log */
+        /*
+         * Print MTU update info to log, history transfer frames are sized
+         * from the current MTU when they are built
+         */
         ESP_LOGI(TAG, "mtu update event; conn_handle=%d cid=%d mtu=%d",
                  event->mtu.conn_handle, event->mtu.channel_id,
                  event->mtu.value);
@@ -256,10 +439,82 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg) {
 
 
 /* Public functions */
+/* Put a new reading into the advertising payload */
+void gap_update_adv_reading(const sample_t *sample) {
+    /* Local variables */
+    int rc;
+
+    portENTER_CRITICAL(&adv_reading_lock);
+    adv_reading[0] = (uint8_t)GAP_ADV_COMPANY_ID;
+    adv_reading[1] = (uint8_t)(GAP_ADV_COMPANY_ID >> 8);
+    adv_reading[2] = ADV_READING_VERSION;
+    adv_reading[3] = (uint8_t)sample->seq;
+    adv_reading[4] = (uint8_t)(sample->seq >> 8);
+    adv_reading[5] = (uint8_t)sample->temperature;
+    adv_reading[6] = (uint8_t)((uint16_t)sample->temperature >> 8);
+    adv_reading[7] = (uint8_t)sample->humidity;
+    adv_reading[8] = (uint8_t)(sample->humidity >> 8);
+    adv_reading_valid = true;
+    portEXIT_CRITICAL(&adv_reading_lock);
+
+    /* Refresh running advertising, otherwise the next start picks it up */
+    if (ble_gap_adv_active()) {
+        rc = set_adv_data();
+        if (rc != 0) {
+            ESP_LOGE(TAG, "failed to update advertising data, error code: %d", rc);
+        }
+    }
+}
+
+/* Notification period changed, renegotiate every connection */
+void gap_set_notify_period(uint32_t period_ms) {
+    /* Local variables */
+    link_event_t link_event = {.type = LINK_EVT_NOTIFY_PERIOD,
+                               .notify_period_ms = period_ms};
+
+    for (int i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; i++) {
+        /* Connections in a bulk transfer pick it up when the transfer ends */
+        if (conn_links[i].in_use && !conn_links[i].bulk) {
+            conn_links[i].update_attempts = 0;
+            apply_link_event(&link_event, conn_links[i].conn_handle);
+        }
+    }
+    /* Without connections only the stored period changes */
+    link_policy.notify_period_ms = period_ms;
+}
+
+/*
+ * Switch a connection to bulk transfer parameters and back. Also asks for
+ * the longest link layer packets, so one notification fits one packet.
+ */
+void gap_set_bulk_transfer(uint16_t conn_handle, bool active) {
+    /* Local variables */
+    int rc;
+    link_event_t link_event = {.type = active ? LINK_EVT_BULK_BEGIN
+                                              : LINK_EVT_BULK_END};
+    conn_link_t *link = conn_link_find(conn_handle);
+
+    if (link == NULL || link->bulk == active) {
+        return;
+    }
+    link->bulk = active;
+    link->update_attempts = 0;
+
+    if (active) {
+        rc = ble_gap_set_data_len(conn_handle, GAP_BULK_TX_OCTETS,
+                                  GAP_BULK_TX_TIME_US);
+        if (rc != 0) {
+            ESP_LOGW(TAG, "failed to set data length, error code: %d", rc);
+        }
+    }
+    apply_link_event(&link_event, conn_handle);
+}
+
 void adv_init(void) {
     /* Local variables */
     int rc = 0;
     char addr_str[18] = {0};
+    link_event_t link_event = {0};
 
     /* Make sure we have proper BT identity address set (random preferred) */
     rc = ble_hs_util_ensure_addr(0);
@@ -284,14 +539,18 @@ void adv_init(void) {
     format_addr(addr_str, addr_val);
     ESP_LOGI(TAG, "device address: %s", addr_str);
 
-    /* Start advertising. */
-    start_advertising();
+    /* Start with fast advertising */
+    link_event.type = LINK_EVT_BOOT;
+    apply_link_event(&link_event, BLE_HS_CONN_HANDLE_NONE);
 }
 
 int gap_init(void) {
     /* Local variables */
     int rc = 0;
 
+    /* Link policy initialization */
+    link_policy_init(&link_policy, GAP_DEFAULT_NOTIFY_PERIOD_MS);
+
     /* Call NimBLE GAP initialization API */
     ble_svc_gap_init();
 
@@ -7,30 +7,200 @@
 #include "gatt_svc.h"
 
 #include "common.h"
+#include "dlog.h"
+#include "ess_trigger.h"
+#include "gap.h"
+#include "history_xfer.h"
+#include "latency_stats.h"
+#include "sample_history.h"
+#include "sampler.h"
+#include "seqlock.h"
 
 /* Private function declarations */
 static int temperature_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
 static int humidity_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int aggregate_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int history_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int record_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int transfer_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int diagnostics_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int ess_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
+static int ess_trigger_dsc_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg);
 
 /* Private variables */
 /* DHT Sensor service */
 static const ble_uuid128_t dht_service_uuid = BLE_UUID128_INIT(0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
 
+/* Latest sample, source of every characteristic value; written by the measure task, read by the host task */
+static sample_t latest_sample_slots[2];
+static seqlock_t latest_sample = SEQLOCK_INIT(latest_sample_slots);
+
 /* Temperature characteristic */
-static uint8_t temperature_chr_val[64] = {0};
 static uint16_t temperature_chr_val_handle;
 static const ble_uuid128_t temperature_chr_uuid = BLE_UUID128_INIT(0x01, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
 
 /* Humidity characteristic */
-static uint8_t humidity_chr_val[64] = {0};
 static uint16_t humidity_chr_val_handle;
 static const ble_uuid128_t humidity_chr_uuid = BLE_UUID128_INIT(0x02, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
 
-/* Connection tracking */
-static uint16_t dht_chr_conn_handle = 0;
-static bool dht_chr_conn_handle_inited = false;
-static bool temperature_notify_status = false;
-static bool humidity_notify_status = false;
+/* Aggregate characteristic: packed sample_agg_t for every window */
+static uint16_t aggregate_chr_val_handle;
+static const ble_uuid128_t aggregate_chr_uuid = BLE_UUID128_INIT(0x03, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
+
+/* History characteristic: write a uint32 sequence cursor, read samples from it */
+#define HISTORY_SAMPLE_SIZE 12
+#define HISTORY_READ_MAX 16
+static uint16_t history_chr_val_handle;
+static const ble_uuid128_t history_chr_uuid = BLE_UUID128_INIT(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
+
+/*
+ * Record characteristic: one packed little-endian sample per notification
+ *   int16  temperature, 0.1 °C
+ *   uint16 humidity, 0.1 %RH
+ *   uint16 sequence number (low 16 bits)
+ *   uint32 timestamp, seconds
+ */
+#define RECORD_SIZE 10
+static uint16_t record_chr_val_handle;
+static const ble_uuid128_t record_chr_uuid = BLE_UUID128_INIT(0x05, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
+
+/*
+ * Transfer characteristic: bulk download of the flash log
+ *   write  uint8 HISTORY_XFER_OP_START, uint32 from timestamp; refused
+ *          with ATT_ERR_CCCD_IMPROPER until notifications are enabled
+ *          uint8 HISTORY_XFER_OP_ABORT
+ *   notify stream frames, see history_xfer.h
+ *   read   report of the last finished transfer
+ */
+static uint16_t transfer_chr_val_handle;
+/* Common profile error code, Client Characteristic Configuration Descriptor Improperly Configured */
+#define ATT_ERR_CCCD_IMPROPER 0xFD
+static const ble_uuid128_t transfer_chr_uuid = BLE_UUID128_INIT(0x06, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
+
+/*
+ * Diagnostics characteristic: sensor to notification latency, per stage
+ * (latency_stage_t order) uint32 count, p50, p90, p99, max in us.
+ * Any write clears the histograms.
+ */
+static uint16_t diagnostics_chr_val_handle;
+static const ble_uuid128_t diagnostics_chr_uuid = BLE_UUID128_INIT(0x07, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff);
+
+/*
+ * Environmental Sensing Service
+ *   Temperature (0x2A6E) sint16, 0.01 °C
+ *   Humidity (0x2A6F) uint16, 0.01 %
+ * each with an ES Trigger Setting descriptor (0x290D) kept per connection
+ */
+#define ESS_SVC_UUID 0x181A
+#define ESS_TEMPERATURE_CHR_UUID 0x2A6E
+#define ESS_HUMIDITY_CHR_UUID 0x2A6F
+#define ESS_TRIGGER_SETTING_DSC_UUID 0x290D
+#define ESS_DEFAULT_CONDITION ESS_TRIGGER_VALUE_CHANGED
+typedef enum {
+    ESS_CHR_TEMPERATURE = 0,
+    ESS_CHR_HUMIDITY,
+    ESS_CHR_COUNT,
+} ess_chr_t;
+static uint16_t ess_chr_val_handles[ESS_CHR_COUNT];
+
+/* Connection tracking, one entry per possible connection */
+#define MAX_CONNECTIONS CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+typedef struct {
+    uint16_t conn_handle;
+    bool in_use;
+    bool temperature_notify;
+    bool humidity_notify;
+    bool record_notify;
+    bool transfer_notify;
+    bool ess_notify[ESS_CHR_COUNT];
+    ess_trigger_t ess_trigger[ESS_CHR_COUNT];
+    uint32_t history_cursor;
+} conn_sub_t;
+static conn_sub_t conn_subs[MAX_CONNECTIONS];
+static portMUX_TYPE conn_subs_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* True while any connection wants sample notifications; must be called with conn_subs_lock held */
+static bool any_sample_subscription(void) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        const conn_sub_t* sub = &conn_subs[i];
+        if (sub->in_use && (sub->temperature_notify || sub->humidity_notify || sub->record_notify ||
+                            sub->ess_notify[ESS_CHR_TEMPERATURE] || sub->ess_notify[ESS_CHR_HUMIDITY])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Fastest an ESS trigger lets this characteristic notify, UINT32_MAX if never */
+static uint32_t ess_notify_period_ms(const ess_trigger_t* trigger) {
+    uint32_t seconds = (uint32_t)trigger->operand;
+
+    switch (trigger->condition) {
+        case ESS_TRIGGER_INACTIVE:
+            return UINT32_MAX;
+        case ESS_TRIGGER_FIXED_INTERVAL:
+        case ESS_TRIGGER_MIN_INTERVAL:
+            if (seconds > UINT32_MAX / 1000) {
+                return UINT32_MAX;
+            }
+            return seconds * 1000 > SAMPLER_PERIOD_MS ? seconds * 1000 : SAMPLER_PERIOD_MS;
+        default:
+            /* Value conditions can fire on any sample */
+            return SAMPLER_PERIOD_MS;
+    }
+}
+
+/*
+ * Shortest time between sample notifications over all connections; must be
+ * called with conn_subs_lock held. Without subscriptions the link keeps
+ * GAP_DEFAULT_NOTIFY_PERIOD_MS, which link_policy turns into slave latency
+ * too: a plain read may wait up to one wake period (about 2 s) for the
+ * peripheral to listen. That is the price of an idle connection that does
+ * not wake the radio on every connection event.
+ */
+static uint32_t sample_notify_period_ms(void) {
+    uint32_t period = UINT32_MAX;
+
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        const conn_sub_t* sub = &conn_subs[i];
+        if (!sub->in_use) {
+            continue;
+        }
+        if (sub->temperature_notify || sub->humidity_notify || sub->record_notify) {
+            period = SAMPLER_PERIOD_MS;
+        }
+        for (int c = 0; c < ESS_CHR_COUNT; c++) {
+            uint32_t ess_period = ess_notify_period_ms(&sub->ess_trigger[c]);
+            if (sub->ess_notify[c] && ess_period < period) {
+                period = ess_period;
+            }
+        }
+    }
+    return period == UINT32_MAX ? GAP_DEFAULT_NOTIFY_PERIOD_MS : period;
+}
+
+/*
+ * Subscriptions or trigger settings changed: start or stop periodic
+ * sampling and renegotiate the links if the notification period moved.
+ * Host task only.
+ */
+static void subscriptions_changed(void) {
+    /* Local variables */
+    static uint32_t applied_period_ms = GAP_DEFAULT_NOTIFY_PERIOD_MS;
+    bool periodic;
+    uint32_t period;
+
+    portENTER_CRITICAL(&conn_subs_lock);
+    periodic = any_sample_subscription();
+    period = sample_notify_period_ms();
+    portEXIT_CRITICAL(&conn_subs_lock);
+
+    sampler_set_periodic(periodic);
+    if (period != applied_period_ms) {
+        applied_period_ms = period;
+        gap_set_notify_period(period);
+    }
+}
 
 /* GATT services table */
 static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
@@ -47,16 +217,99 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
                                                      .access_cb = humidity_chr_access,
                                                      .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
                                                      .val_handle = &humidity_chr_val_handle},
+                                                    {/* Record characteristic */
+                                                     .uuid = &record_chr_uuid.u,
+                                                     .access_cb = record_chr_access,
+                                                     .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                                                     .val_handle = &record_chr_val_handle},
+                                                    {/* Aggregate characteristic */
+                                                     .uuid = &aggregate_chr_uuid.u,
+                                                     .access_cb = aggregate_chr_access,
+                                                     .flags = BLE_GATT_CHR_F_READ,
+                                                     .val_handle = &aggregate_chr_val_handle},
+                                                    {/* History characteristic */
+                                                     .uuid = &history_chr_uuid.u,
+                                                     .access_cb = history_chr_access,
+                                                     .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                                                     .val_handle = &history_chr_val_handle},
+                                                    {/* Transfer characteristic */
+                                                     .uuid = &transfer_chr_uuid.u,
+                                                     .access_cb = transfer_chr_access,
+                                                     .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_NOTIFY,
+                                                     .val_handle = &transfer_chr_val_handle},
+                                                    {/* Diagnostics characteristic */
+                                                     .uuid = &diagnostics_chr_uuid.u,
+                                                     .access_cb = diagnostics_chr_access,
+                                                     .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                                                     .val_handle = &diagnostics_chr_val_handle},
                                                     {
                                                         0, /* No more characteristics in this service. */
                                                     }}},
 
+    /* Environmental Sensing service */
+    {.type = BLE_GATT_SVC_TYPE_PRIMARY,
+     .uuid = BLE_UUID16_DECLARE(ESS_SVC_UUID),
+     .characteristics =
+         (struct ble_gatt_chr_def[]){{/* Temperature characteristic */
+                                      .uuid = BLE_UUID16_DECLARE(ESS_TEMPERATURE_CHR_UUID),
+                                      .access_cb = ess_chr_access,
+                                      .arg = (void*)ESS_CHR_TEMPERATURE,
+                                      .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                                      .val_handle = &ess_chr_val_handles[ESS_CHR_TEMPERATURE],
+                                      .descriptors = (struct ble_gatt_dsc_def[]){{.uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_SETTING_DSC_UUID),
+                                                                                  .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+                                                                                  .access_cb = ess_trigger_dsc_access,
+                                                                                  .arg = (void*)ESS_CHR_TEMPERATURE},
+                                                                                 {
+                                                                                     0, /* No more descriptors. */
+                                                                                 }}},
+                                     {/* Humidity characteristic */
+                                      .uuid = BLE_UUID16_DECLARE(ESS_HUMIDITY_CHR_UUID),
+                                      .access_cb = ess_chr_access,
+                                      .arg = (void*)ESS_CHR_HUMIDITY,
+                                      .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                                      .val_handle = &ess_chr_val_handles[ESS_CHR_HUMIDITY],
+                                      .descriptors = (struct ble_gatt_dsc_def[]){{.uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_SETTING_DSC_UUID),
+                                                                                  .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+                                                                                  .access_cb = ess_trigger_dsc_access,
+                                                                                  .arg = (void*)ESS_CHR_HUMIDITY},
+                                                                                 {
+                                                                                     0, /* No more descriptors. */
+                                                                                 }}},
+                                     {
+                                         0, /* No more characteristics in this service. */
+                                     }}},
+
     {
         0, /* No more services. */
     },
 };
 
 /* Private functions */
+/* Find the table entry of a connection; must be called with conn_subs_lock held */
+static conn_sub_t* conn_sub_find(uint16_t conn_handle) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (conn_subs[i].in_use && conn_subs[i].conn_handle == conn_handle) {
+            return &conn_subs[i];
+        }
+    }
+    return NULL;
+}
+
+/* Format a value in tenths as "12.3" without pulling in float printf */
+static int format_tenths(char* buf, size_t size, int32_t tenths, const char* unit) {
+    const char* sign = tenths < 0 ? "-" : "";
+    uint32_t abs_val = tenths < 0 ? (uint32_t)(-tenths) : (uint32_t)tenths;
+    return snprintf(buf, size, "%s%lu.%lu%s", sign, (unsigned long)(abs_val / 10), (unsigned long)(abs_val % 10), unit);
+}
+
+/* Client reads are answered from the cache and have a stale one refreshed; reads done by the stack while notifying need not */
+static void refresh_for_read(uint16_t conn_handle) {
+    if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+        sampler_refresh();
+    }
+}
+
 static int temperature_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
     /* Local variables */
     int rc;
@@ -67,15 +320,19 @@ static int temperature_chr_access(uint16_t conn_handle, uint16_t attr_handle, st
         case BLE_GATT_ACCESS_OP_READ_CHR:
             /* Verify connection handle */
             if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
-                ESP_LOGI(TAG, "temperature read; conn_handle=%d attr_handle=%d", conn_handle, attr_handle);
+                DLOG(TAG, "temperature read; conn_handle=%d attr_handle=%d", conn_handle, attr_handle);
             } else {
-                ESP_LOGI(TAG, "temperature read by nimble stack; attr_handle=%d", attr_handle);
+                DLOG(TAG, "temperature read by nimble stack; attr_handle=%d", attr_handle);
             }
 
             /* Verify attribute handle */
             if (attr_handle == temperature_chr_val_handle) {
                 /* Send current temperature value */
-                rc = os_mbuf_append(ctxt->om, &temperature_chr_val, sizeof(temperature_chr_val));
+                char str[16] = {0};
+                sample_t sample;
+                refresh_for_read(conn_handle);
+                int len = seqlock_read(&latest_sample, &sample) ? format_tenths(str, sizeof(str), sample.temperature, "°C") : 0;
+                rc = os_mbuf_append(ctxt->om, str, len);
                 return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
             }
             goto error;
@@ -100,15 +357,19 @@ static int humidity_chr_access(uint16_t conn_handle, uint16_t attr_handle, struc
         case BLE_GATT_ACCESS_OP_READ_CHR:
             /* Verify connection handle */
             if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
-                ESP_LOGI(TAG, "humidity read; conn_handle=%d attr_handle=%d", conn_handle, attr_handle);
+                DLOG(TAG, "humidity read; conn_handle=%d attr_handle=%d", conn_handle, attr_handle);
             } else {
-                ESP_LOGI(TAG, "humidity read by nimble stack; attr_handle=%d", attr_handle);
+                DLOG(TAG, "humidity read by nimble stack; attr_handle=%d", attr_handle);
             }
 
             /* Verify attribute handle */
             if (attr_handle == humidity_chr_val_handle) {
                 /* Send current humidity value */
-                rc = os_mbuf_append(ctxt->om, &humidity_chr_val, sizeof(humidity_chr_val));
+                char str[16] = {0};
+                sample_t sample;
+                refresh_for_read(conn_handle);
+                int len = seqlock_read(&latest_sample, &sample) ? format_tenths(str, sizeof(str), sample.humidity, "%") : 0;
+                rc = os_mbuf_append(ctxt->om, str, len);
                 return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
             }
             goto error;
@@ -123,27 +384,338 @@ error:
     return BLE_ATT_ERR_UNLIKELY;
 }
 
-/* Public functions */
-void send_temperature_humidity_notification(float temperature, float humidity) {
-    char temp_str[16];
-    char hum_str[16];
-    int temp_len, hum_len;
+static void put_le16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
 
-    /* Format temperature as string */
-    temp_len = snprintf((char*)temperature_chr_val, sizeof(temperature_chr_val), "%.1f°C", temperature);
+static void encode_record(uint8_t* buf, const sample_t* sample) {
+    put_le16(buf + 0, (uint16_t)sample->temperature);
+    put_le16(buf + 2, sample->humidity);
+    put_le16(buf + 4, (uint16_t)sample->seq);
+    put_le32(buf + 6, sample->timestamp);
+}
 
-    /* Format humidity as string */
-    hum_len = snprintf((char*)humidity_chr_val, sizeof(humidity_chr_val), "%.1f%%", humidity);
+/* The sample counts as queued once the stack accepted its first notification */
+static void mark_queued(bool* queued, int rc) {
+    if (rc == 0 && !*queued) {
+        *queued = true;
+        latency_mark(LATENCY_MARK_QUEUED);
+    }
+}
+
+static int record_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    uint8_t buf[RECORD_SIZE];
+    sample_t sample;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR || attr_handle != record_chr_val_handle) {
+        ESP_LOGE(TAG, "unexpected access operation to record characteristic, opcode: %d", ctxt->op);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    refresh_for_read(conn_handle);
+    if (!seqlock_read(&latest_sample, &sample)) {
+        return 0;
+    }
+
+    encode_record(buf, &sample);
+    return os_mbuf_append(ctxt->om, buf, sizeof(buf)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+/* ESS values are in hundredths, samples in tenths */
+static int32_t ess_value(ess_chr_t chr, const sample_t* sample) {
+    return chr == ESS_CHR_TEMPERATURE ? (int32_t)sample->temperature * 10 : (int32_t)sample->humidity * 10;
+}
+
+static int ess_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    ess_chr_t chr = (ess_chr_t)(intptr_t)arg;
+    uint8_t buf[2];
+    sample_t sample;
 
-    /* Send notifications if client is subscribed */
-    if (dht_chr_conn_handle_inited) {
-        if (temperature_notify_status) {
-            ble_gatts_notify(dht_chr_conn_handle, temperature_chr_val_handle);
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR || attr_handle != ess_chr_val_handles[chr]) {
+        ESP_LOGE(TAG, "unexpected access operation to ESS characteristic, opcode: %d", ctxt->op);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    refresh_for_read(conn_handle);
+    if (!seqlock_read(&latest_sample, &sample)) {
+        return 0;
+    }
+
+    put_le16(buf, (uint16_t)ess_value(chr, &sample));
+    return os_mbuf_append(ctxt->om, buf, sizeof(buf)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int ess_trigger_dsc_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    ess_chr_t chr = (ess_chr_t)(intptr_t)arg;
+    uint8_t buf[ESS_TRIGGER_MAX_LEN];
+    uint16_t len = 0;
+    ess_trigger_t trigger;
+    conn_sub_t* sub;
+
+    switch (ctxt->op) {
+        /* Trigger setting of the connection, or the default for the stack */
+        case BLE_GATT_ACCESS_OP_READ_DSC:
+            ess_trigger_init(&trigger, ESS_DEFAULT_CONDITION, 0);
+            portENTER_CRITICAL(&conn_subs_lock);
+            sub = conn_sub_find(conn_handle);
+            if (sub != NULL) {
+                trigger = sub->ess_trigger[chr];
+            }
+            portEXIT_CRITICAL(&conn_subs_lock);
+            len = ess_trigger_encode(&trigger, buf);
+            return os_mbuf_append(ctxt->om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+        /* New trigger setting, applies to this connection only */
+        case BLE_GATT_ACCESS_OP_WRITE_DSC:
+            if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0 ||
+                ess_trigger_parse(&trigger, buf, len, chr == ESS_CHR_TEMPERATURE) != 0) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            portENTER_CRITICAL(&conn_subs_lock);
+            sub = conn_sub_find(conn_handle);
+            if (sub != NULL) {
+                sub->ess_trigger[chr] = trigger;
+            }
+            portEXIT_CRITICAL(&conn_subs_lock);
+            ESP_LOGI(TAG, "ESS trigger set; conn_handle=%d chr=%d condition=%d", conn_handle, chr, trigger.condition);
+            subscriptions_changed();
+            return sub != NULL ? 0 : BLE_ATT_ERR_UNLIKELY;
+
+        default:
+            ESP_LOGE(TAG, "unexpected access operation to ESS trigger descriptor, opcode: %d", ctxt->op);
+            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+static int aggregate_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    uint8_t buf[SAMPLE_WINDOW_COUNT * 14];
+    uint8_t* p = buf;
+    sample_agg_t agg;
+    uint32_t now;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR || attr_handle != aggregate_chr_val_handle) {
+        ESP_LOGE(TAG, "unexpected access operation to aggregate characteristic, opcode: %d", ctxt->op);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    /* Have a stale sample refreshed, then expire whatever left the windows since */
+    refresh_for_read(conn_handle);
+    now = sample_history_now();
+    for (int i = 0; i < SAMPLE_WINDOW_COUNT; i++) {
+        sample_history_get_agg((sample_window_id_t)i, now, &agg);
+        put_le16(p + 0, agg.count);
+        put_le16(p + 2, (uint16_t)agg.temperature_min);
+        put_le16(p + 4, (uint16_t)agg.temperature_max);
+        put_le16(p + 6, (uint16_t)agg.temperature_mean);
+        put_le16(p + 8, agg.humidity_min);
+        put_le16(p + 10, agg.humidity_max);
+        put_le16(p + 12, agg.humidity_mean);
+        p += 14;
+    }
+
+    return os_mbuf_append(ctxt->om, buf, sizeof(buf)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int history_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    sample_t samples[HISTORY_READ_MAX];
+    uint8_t buf[HISTORY_READ_MAX * HISTORY_SAMPLE_SIZE];
+    uint8_t cursor[4];
+    uint16_t len;
+    size_t n;
+    conn_sub_t* sub;
+    uint32_t seq;
+
+    if (attr_handle != history_chr_val_handle) {
+        goto error;
+    }
+
+    switch (ctxt->op) {
+        /* Client sets the sequence number it wants to continue from */
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            if (ble_hs_mbuf_to_flat(ctxt->om, cursor, sizeof(cursor), &len) != 0 || len != sizeof(cursor)) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            portENTER_CRITICAL(&conn_subs_lock);
+            sub = conn_sub_find(conn_handle);
+            if (sub != NULL) {
+                sub->history_cursor = (uint32_t)cursor[0] | ((uint32_t)cursor[1] << 8) | ((uint32_t)cursor[2] << 16) | ((uint32_t)cursor[3] << 24);
+            }
+            portEXIT_CRITICAL(&conn_subs_lock);
+            return 0;
+
+        /* Up to HISTORY_READ_MAX samples starting at the cursor */
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            portENTER_CRITICAL(&conn_subs_lock);
+            sub = conn_sub_find(conn_handle);
+            seq = sub != NULL ? sub->history_cursor : 0;
+            portEXIT_CRITICAL(&conn_subs_lock);
+            n = sample_history_read_since(seq, samples, HISTORY_READ_MAX);
+            for (size_t i = 0; i < n; i++) {
+                uint8_t* p = &buf[i * HISTORY_SAMPLE_SIZE];
+                put_le32(p + 0, samples[i].seq);
+                put_le32(p + 4, samples[i].timestamp);
+                put_le16(p + 8, (uint16_t)samples[i].temperature);
+                put_le16(p + 10, samples[i].humidity);
+            }
+            return os_mbuf_append(ctxt->om, buf, n * HISTORY_SAMPLE_SIZE) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+        default:
+            goto error;
+    }
+
+error:
+    ESP_LOGE(TAG, "unexpected access operation to history characteristic, opcode: %d", ctxt->op);
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+static int transfer_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    uint8_t buf[HISTORY_XFER_REPORT_SIZE];
+    history_xfer_report_t report;
+    uint16_t len;
+    conn_sub_t* sub;
+    bool subscribed;
+
+    if (attr_handle != transfer_chr_val_handle) {
+        goto error;
+    }
+
+    switch (ctxt->op) {
+        /* Control point: start from a timestamp, or abort */
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0 || len < 1) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            if (buf[0] == HISTORY_XFER_OP_ABORT && len == 1) {
+                history_xfer_abort(conn_handle);
+                return 0;
+            }
+            if (buf[0] == HISTORY_XFER_OP_START && len == 5) {
+                /* The stream is notifications only, nobody would see it */
+                portENTER_CRITICAL(&conn_subs_lock);
+                sub = conn_sub_find(conn_handle);
+                subscribed = sub != NULL && sub->transfer_notify;
+                portEXIT_CRITICAL(&conn_subs_lock);
+                if (!subscribed) {
+                    return ATT_ERR_CCCD_IMPROPER;
+                }
+                return history_xfer_start(conn_handle, transfer_chr_val_handle,
+                                          (uint32_t)buf[1] | ((uint32_t)buf[2] << 8) | ((uint32_t)buf[3] << 16) | ((uint32_t)buf[4] << 24));
+            }
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+
+        /* Throughput report of the last transfer */
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            history_xfer_last_report(&report);
+            len = history_xfer_encode_report(&report, buf);
+            return os_mbuf_append(ctxt->om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+        default:
+            goto error;
+    }
+
+error:
+    ESP_LOGE(TAG, "unexpected access operation to transfer characteristic, opcode: %d", ctxt->op);
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+static int diagnostics_chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    /* Local variables */
+    uint8_t buf[LATENCY_STAGE_COUNT * LATENCY_SUMMARY_SIZE];
+    size_t len;
+
+    if (attr_handle != diagnostics_chr_val_handle) {
+        goto error;
+    }
+
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            len = latency_encode(buf, sizeof(buf));
+            return os_mbuf_append(ctxt->om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            latency_reset();
+            ESP_LOGI(TAG, "latency histograms cleared; conn_handle=%d", conn_handle);
+            return 0;
+
+        default:
+            goto error;
+    }
+
+error:
+    ESP_LOGE(TAG, "unexpected access operation to diagnostics characteristic, opcode: %d", ctxt->op);
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+/* Public functions */
+void send_temperature_humidity_notification(const sample_t* sample) {
+    /* Local variables */
+    uint8_t record[RECORD_SIZE];
+    struct os_mbuf* om;
+    uint8_t ess_buf[2];
+    conn_sub_t subs[MAX_CONNECTIONS];
+    bool ess_send[MAX_CONNECTIONS][ESS_CHR_COUNT] = {0};
+    bool queued = false;
+    int sent = 0;
+
+    /* Publish the sample; string values are formatted on read */
+    seqlock_write(&latest_sample, sample);
+
+    /*
+     * Snapshot the table so the host task can keep updating it, and run
+     * the ESS trigger filters of every connection on the new sample
+     */
+    portENTER_CRITICAL(&conn_subs_lock);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        for (int c = 0; c < ESS_CHR_COUNT; c++) {
+            if (conn_subs[i].in_use && conn_subs[i].ess_notify[c]) {
+                ess_send[i][c] = ess_trigger_evaluate(&conn_subs[i].ess_trigger[c], ess_value((ess_chr_t)c, sample), sample->timestamp);
+            }
         }
-        if (humidity_notify_status) {
-            ble_gatts_notify(dht_chr_conn_handle, humidity_chr_val_handle);
+    }
+    memcpy(subs, conn_subs, sizeof(subs));
+    portEXIT_CRITICAL(&conn_subs_lock);
+
+    /* Fan out to every subscribed connection */
+    encode_record(record, sample);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (!subs[i].in_use) {
+            continue;
+        }
+        if (subs[i].temperature_notify) {
+            mark_queued(&queued, ble_gatts_notify(subs[i].conn_handle, temperature_chr_val_handle));
+        }
+        if (subs[i].humidity_notify) {
+            mark_queued(&queued, ble_gatts_notify(subs[i].conn_handle, humidity_chr_val_handle));
         }
-        ESP_LOGI(TAG, "DHT data sent: Temp=%.1fC, Humidity=%.1f%%", temperature, humidity);
+        if (subs[i].record_notify) {
+            om = ble_hs_mbuf_from_flat(record, sizeof(record));
+            if (om != NULL) {
+                mark_queued(&queued, ble_gatts_notify_custom(subs[i].conn_handle, record_chr_val_handle, om));
+            }
+        }
+        for (int c = 0; c < ESS_CHR_COUNT; c++) {
+            if (ess_send[i][c]) {
+                put_le16(ess_buf, (uint16_t)ess_value((ess_chr_t)c, sample));
+                om = ble_hs_mbuf_from_flat(ess_buf, sizeof(ess_buf));
+                if (om != NULL) {
+                    mark_queued(&queued, ble_gatts_notify_custom(subs[i].conn_handle, ess_chr_val_handles[c], om));
+                }
+            }
+        }
+        sent++;
+    }
+    if (sent > 0) {
+        DLOG(TAG, "DHT data sent: seq=%lu connections=%d", sample->seq, sent);
     }
 }
 
@@ -186,7 +758,7 @@ void gatt_svr_register_cb(struct ble_gatt_register_ctxt* ctxt, void* arg) {
 
 /*
  *  GATT server subscribe event callback
- *      1. Update heart rate subscription status
+ *      1. Update subscription status of the connection
  */
 
 void gatt_svr_subscribe_cb(struct ble_gap_event* event) {
@@ -197,18 +769,86 @@ void gatt_svr_subscribe_cb(struct ble_gap_event* event) {
         ESP_LOGI(TAG, "subscribe by nimble stack; attr_handle=%d", event->subscribe.attr_handle);
     }
 
-    /* Update connection handle */
-    dht_chr_conn_handle = event->subscribe.conn_handle;
-    dht_chr_conn_handle_inited = true;
+    /* Update subscription status of this connection */
+    portENTER_CRITICAL(&conn_subs_lock);
+    conn_sub_t* sub = conn_sub_find(event->subscribe.conn_handle);
+    if (sub != NULL) {
+        if (event->subscribe.attr_handle == temperature_chr_val_handle) {
+            sub->temperature_notify = event->subscribe.cur_notify;
+        } else if (event->subscribe.attr_handle == humidity_chr_val_handle) {
+            sub->humidity_notify = event->subscribe.cur_notify;
+        } else if (event->subscribe.attr_handle == record_chr_val_handle) {
+            sub->record_notify = event->subscribe.cur_notify;
+        } else if (event->subscribe.attr_handle == transfer_chr_val_handle) {
+            sub->transfer_notify = event->subscribe.cur_notify;
+        }
+        for (int c = 0; c < ESS_CHR_COUNT; c++) {
+            if (event->subscribe.attr_handle == ess_chr_val_handles[c]) {
+                sub->ess_notify[c] = event->subscribe.cur_notify;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&conn_subs_lock);
+    subscriptions_changed();
+
+    /* Nobody listens to the stream any more */
+    if (event->subscribe.attr_handle == transfer_chr_val_handle && !event->subscribe.cur_notify) {
+        history_xfer_abort(event->subscribe.conn_handle);
+    }
+
+    if (sub == NULL) {
+        ESP_LOGW(TAG, "subscribe event for untracked connection %d", event->subscribe.conn_handle);
+        return;
+    }
+    ESP_LOGI(TAG, "conn_handle=%d notifications %s for attr_handle=%d", event->subscribe.conn_handle,
+             event->subscribe.cur_notify ? "enabled" : "disabled", event->subscribe.attr_handle);
+}
+
+/*
+ *  GATT server notification sent callback
+ *      - Sample notifications handed to the controller close the latency trace
+ */
+void gatt_svr_notify_tx_cb(struct ble_gap_event* event) {
+    uint16_t handle = event->notify_tx.attr_handle;
+
+    if (event->notify_tx.status != 0 || event->notify_tx.indication) {
+        return;
+    }
+    if (handle == temperature_chr_val_handle || handle == humidity_chr_val_handle || handle == record_chr_val_handle ||
+        handle == ess_chr_val_handles[ESS_CHR_TEMPERATURE] || handle == ess_chr_val_handles[ESS_CHR_HUMIDITY]) {
+        latency_tx_done();
+    }
+}
+
+/*
+ *  GATT connection callbacks
+ *      - gatt_svr_connect_cb claims a subscription table entry
+ *      - gatt_svr_disconnect_cb releases it
+ */
+void gatt_svr_connect_cb(uint16_t conn_handle) {
+    portENTER_CRITICAL(&conn_subs_lock);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (!conn_subs[i].in_use) {
+            conn_subs[i] = (conn_sub_t){.conn_handle = conn_handle, .in_use = true};
+            for (int c = 0; c < ESS_CHR_COUNT; c++) {
+                ess_trigger_init(&conn_subs[i].ess_trigger[c], ESS_DEFAULT_CONDITION, 0);
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&conn_subs_lock);
+}
+
+void gatt_svr_disconnect_cb(uint16_t conn_handle) {
+    history_xfer_abort(conn_handle);
 
-    /* Check attribute handle and update subscription status */
-    if (event->subscribe.attr_handle == temperature_chr_val_handle) {
-        temperature_notify_status = event->subscribe.cur_notify;
-        ESP_LOGI(TAG, "temperature notifications %s", temperature_notify_status ? "enabled" : "disabled");
-    } else if (event->subscribe.attr_handle == humidity_chr_val_handle) {
-        humidity_notify_status = event->subscribe.cur_notify;
-        ESP_LOGI(TAG, "humidity notifications %s", humidity_notify_status ? "enabled" : "disabled");
+    portENTER_CRITICAL(&conn_subs_lock);
+    conn_sub_t* sub = conn_sub_find(conn_handle);
+    if (sub != NULL) {
+        sub->in_use = false;
     }
+    portEXIT_CRITICAL(&conn_subs_lock);
+    subscriptions_changed();
 }
 
 /*
@@ -223,6 +863,7 @@ int gatt_svc_init(void) {
 
     /* 1. GATT service initialization */
     ble_svc_gatt_init();
+    history_xfer_init();
 
     /* 2. Update GATT services counter */
     rc = ble_gatts_count_cfg(gatt_svr_svcs);
@@ -0,0 +1,282 @@
+/* Includes */
+#include "history_xfer.h"
+
+#include "common.h"
+#include "esp_timer.h"
+#include "gap.h"
+#include "sampler.h"
+#include "sensor_log.h"
+
+/* Defines */
+#define MAX_CONNECTIONS CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+/* Largest frame, for an ATT MTU of 512 */
+#define FRAME_MAX 509
+/* Frames sent before yielding to other host events */
+#define XFER_BURST 8
+/* Retry delay when the host is out of mbufs */
+#define XFER_BACKOFF_MS 5
+
+/* Per connection transfer state */
+typedef struct {
+    bool in_use;
+    uint16_t conn_handle;
+    uint16_t val_handle;
+    /* Waiting for the measurement task to flush the log before seeking */
+    bool wait_flush;
+    uint32_t from_timestamp;
+    sensor_log_cursor_t cursor;
+    bool log_done;
+    /* Chunk being cut into frames */
+    uint8_t chunk[SENSOR_LOG_CHUNK_SIZE];
+    size_t chunk_len;
+    size_t chunk_off;
+    /* Built but not yet accepted frame */
+    uint8_t frame[FRAME_MAX];
+    size_t frame_len;
+    uint16_t frame_seq;
+    bool end_queued;
+    history_xfer_report_t report;
+    uint32_t frames;
+    int64_t started_us;
+    struct ble_npl_event ev;
+    struct ble_npl_callout backoff;
+} xfer_t;
+
+/* Private function declarations */
+static void xfer_pump(xfer_t* x);
+
+/* Private variables */
+static xfer_t xfers[MAX_CONNECTIONS];
+static history_xfer_report_t last_report;
+static struct ble_npl_event flushed_ev;
+
+/* Private functions */
+static void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static xfer_t* xfer_find(uint16_t conn_handle) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (xfers[i].in_use && xfers[i].conn_handle == conn_handle) {
+            return &xfers[i];
+        }
+    }
+    return NULL;
+}
+
+static void xfer_event_cb(struct ble_npl_event* ev) {
+    xfer_pump((xfer_t*)ble_npl_event_get_arg(ev));
+}
+
+static void xfer_finish(xfer_t* x, history_xfer_status_t status) {
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - x->started_us) / 1000);
+
+    ble_npl_callout_stop(&x->backoff);
+    ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &x->ev);
+
+    x->report.status = status;
+    x->report.duration_ms = ms;
+    x->report.bytes_per_sec = ms > 0 ? (uint32_t)((uint64_t)x->report.bytes * 1000 / ms) : 0;
+    last_report = x->report;
+    x->in_use = false;
+
+    ESP_LOGI(TAG, "history transfer %s; conn_handle=%d bytes=%lu chunks=%lu frames=%lu time=%lums rate=%luB/s",
+             status == HISTORY_XFER_DONE ? "done" : "stopped", x->conn_handle, (unsigned long)x->report.bytes,
+             (unsigned long)x->report.chunks, (unsigned long)x->frames, (unsigned long)ms,
+             (unsigned long)x->report.bytes_per_sec);
+
+    gap_set_bulk_transfer(x->conn_handle, false);
+}
+
+/* Fill the next frame from the log stream; false when nothing is left */
+static bool xfer_build_frame(xfer_t* x) {
+    size_t max = ble_att_mtu(x->conn_handle);
+    size_t len = HISTORY_XFER_FRAME_HEADER_SIZE;
+
+    max = max > 3 ? max - 3 : 0;
+    if (max > FRAME_MAX) {
+        max = FRAME_MAX;
+    }
+
+    while (len < max) {
+        if (x->chunk_off == x->chunk_len) {
+            if (x->log_done || sensor_log_next_chunk(&x->cursor, x->chunk, &x->chunk_len) != ESP_OK) {
+                x->log_done = true;
+                break;
+            }
+            x->chunk_off = 0;
+            x->report.chunks++;
+        }
+        size_t n = x->chunk_len - x->chunk_off;
+        if (n > max - len) {
+            n = max - len;
+        }
+        memcpy(&x->frame[len], &x->chunk[x->chunk_off], n);
+        x->chunk_off += n;
+        len += n;
+    }
+
+    if (len > HISTORY_XFER_FRAME_HEADER_SIZE) {
+        x->frame[0] = HISTORY_XFER_FRAME_DATA;
+        x->report.bytes += len - HISTORY_XFER_FRAME_HEADER_SIZE;
+    } else if (!x->end_queued) {
+        /* Stream drained: close it with the report */
+        x->frame[0] = HISTORY_XFER_FRAME_END;
+        x->report.status = HISTORY_XFER_DONE;
+        x->report.duration_ms = (uint32_t)((esp_timer_get_time() - x->started_us) / 1000);
+        x->report.bytes_per_sec = x->report.duration_ms > 0 ? (uint32_t)((uint64_t)x->report.bytes * 1000 / x->report.duration_ms) : 0;
+        len += history_xfer_encode_report(&x->report, &x->frame[len]);
+        x->end_queued = true;
+    } else {
+        return false;
+    }
+
+    x->frame[1] = (uint8_t)x->frame_seq;
+    x->frame[2] = (uint8_t)(x->frame_seq >> 8);
+    x->frame_seq++;
+    x->frame_len = len;
+    return true;
+}
+
+/*
+ * Send up to XFER_BURST frames. A frame stays pending until the host
+ * accepts it; when mbufs run out the pump backs off and retries.
+ */
+static void xfer_pump(xfer_t* x) {
+    struct os_mbuf* om;
+    int rc;
+
+    if (!x->in_use || x->wait_flush) {
+        return;
+    }
+
+    for (int i = 0; i < XFER_BURST; i++) {
+        if (x->frame_len == 0 && !xfer_build_frame(x)) {
+            xfer_finish(x, HISTORY_XFER_DONE);
+            return;
+        }
+
+        om = ble_hs_mbuf_from_flat(x->frame, x->frame_len);
+        if (om == NULL) {
+            ble_npl_callout_reset(&x->backoff, ble_npl_time_ms_to_ticks32(XFER_BACKOFF_MS));
+            return;
+        }
+        rc = ble_gatts_notify_custom(x->conn_handle, x->val_handle, om);
+        if (rc == BLE_HS_ENOMEM) {
+            ble_npl_callout_reset(&x->backoff, ble_npl_time_ms_to_ticks32(XFER_BACKOFF_MS));
+            return;
+        }
+        if (rc != 0) {
+            ESP_LOGE(TAG, "history transfer notify failed, error code: %d", rc);
+            xfer_finish(x, HISTORY_XFER_FAILED);
+            return;
+        }
+        x->frame_len = 0;
+        x->frames++;
+    }
+
+    /* Let other host events run before the next burst */
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &x->ev);
+}
+
+/* The log is on flash now: position every waiting transfer and start it */
+static void xfer_flushed_cb(struct ble_npl_event* ev) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        xfer_t* x = &xfers[i];
+
+        if (!x->in_use || !x->wait_flush) {
+            continue;
+        }
+        x->wait_flush = false;
+        if (sensor_log_seek(x->from_timestamp, &x->cursor) != ESP_OK) {
+            xfer_finish(x, HISTORY_XFER_FAILED);
+            continue;
+        }
+        xfer_pump(x);
+    }
+}
+
+/* Public functions */
+void history_xfer_init(void) {
+    ble_npl_event_init(&flushed_ev, xfer_flushed_cb, NULL);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        ble_npl_event_init(&xfers[i].ev, xfer_event_cb, &xfers[i]);
+        ble_npl_callout_init(&xfers[i].backoff, nimble_port_get_dflt_eventq(), xfer_event_cb, &xfers[i]);
+    }
+}
+
+/* Start streaming the log from a timestamp, returns an ATT error code */
+int history_xfer_start(uint16_t conn_handle, uint16_t val_handle, uint32_t from_timestamp) {
+    /* Local variables */
+    xfer_t* x = xfer_find(conn_handle);
+
+    /* A new start replaces a running transfer */
+    if (x != NULL) {
+        xfer_finish(x, HISTORY_XFER_ABORTED);
+        x = NULL;
+    }
+    for (int i = 0; i < MAX_CONNECTIONS && x == NULL; i++) {
+        if (!xfers[i].in_use) {
+            x = &xfers[i];
+        }
+    }
+    if (x == NULL) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    x->in_use = true;
+    x->conn_handle = conn_handle;
+    x->val_handle = val_handle;
+    x->wait_flush = true;
+    x->from_timestamp = from_timestamp;
+    x->log_done = false;
+    x->chunk_len = 0;
+    x->chunk_off = 0;
+    x->frame_len = 0;
+    x->frame_seq = 0;
+    x->end_queued = false;
+    memset(&x->report, 0, sizeof(x->report));
+    x->frames = 0;
+    x->started_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "history transfer started; conn_handle=%d from=%lu mtu=%d", conn_handle, (unsigned long)from_timestamp,
+             ble_att_mtu(conn_handle));
+
+    /* Include the samples still buffered in RAM, the stream starts from xfer_flushed_cb */
+    gap_set_bulk_transfer(conn_handle, true);
+    sampler_request_flush();
+    return 0;
+}
+
+/* Client abort, unsubscribe or disconnect */
+void history_xfer_abort(uint16_t conn_handle) {
+    xfer_t* x = xfer_find(conn_handle);
+
+    if (x != NULL) {
+        xfer_finish(x, HISTORY_XFER_ABORTED);
+    }
+}
+
+bool history_xfer_active(uint16_t conn_handle) {
+    return xfer_find(conn_handle) != NULL;
+}
+
+void history_xfer_last_report(history_xfer_report_t* report) {
+    *report = last_report;
+}
+
+void history_xfer_log_flushed(void) {
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &flushed_ev);
+}
+
+size_t history_xfer_encode_report(const history_xfer_report_t* report, uint8_t* buf) {
+    buf[0] = report->status;
+    put_le32(buf + 1, report->bytes);
+    put_le32(buf + 5, report->chunks);
+    put_le32(buf + 9, report->duration_ms);
+    put_le32(buf + 13, report->bytes_per_sec);
+    return HISTORY_XFER_REPORT_SIZE;
+}
@@ -0,0 +1,162 @@
+/* Includes */
+#include "latency_stats.h"
+
+#include <string.h>
+
+/* ESP APIs */
+#include "esp_log.h"
+#include "esp_timer.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+
+/* Defines */
+#define LOG_TAG "Latency"
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+} latency_hist_t;
+
+/* Private variables */
+static const char* const stage_names[LATENCY_STAGE_COUNT] = {"read", "format", "publish", "tx", "total"};
+static latency_hist_t hists[LATENCY_STAGE_COUNT];
+static int64_t marks[LATENCY_MARK_COUNT];
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Private functions */
+/* Four buckets per power of two: 0..3 exact, then 4-7, 8-15, ... split in quarters */
+static size_t bucket_index(uint32_t us) {
+    size_t idx;
+    unsigned octave;
+
+    if (us < LATENCY_SUB_BUCKETS) {
+        return us;
+    }
+    octave = 31 - (unsigned)__builtin_clz(us);
+    idx = (octave - 1) * LATENCY_SUB_BUCKETS + ((us >> (octave - 2)) & (LATENCY_SUB_BUCKETS - 1));
+    return idx < LATENCY_BUCKETS ? idx : LATENCY_BUCKETS - 1;
+}
+
+static uint32_t bucket_lower(size_t idx) {
+    if (idx < LATENCY_SUB_BUCKETS) {
+        return (uint32_t)idx;
+    }
+    return (uint32_t)(LATENCY_SUB_BUCKETS + idx % LATENCY_SUB_BUCKETS) << (idx / LATENCY_SUB_BUCKETS - 1);
+}
+
+/* Must be called with latency_lock held */
+static void hist_record(latency_stage_t stage, int64_t us) {
+    latency_hist_t* h = &hists[stage];
+    uint32_t v = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+
+    h->buckets[bucket_index(v)]++;
+    h->count++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/* Upper edge of the bucket holding the given fraction of samples, capped at max */
+static uint32_t hist_percentile(const latency_hist_t* h, uint32_t permille) {
+    uint64_t target = ((uint64_t)h->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    if (h->count == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            uint32_t upper = i + 1 < LATENCY_BUCKETS ? bucket_lower(i + 1) - 1 : UINT32_MAX;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Public functions */
+/* Called from the measurement task as a sample moves through the stages */
+void latency_mark(latency_mark_t mark) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&latency_lock);
+    if (mark == LATENCY_MARK_READ_START) {
+        memset(marks, 0, sizeof(marks));
+    } else if (marks[mark - 1] != 0) {
+        hist_record((latency_stage_t)(mark - 1), now - marks[mark - 1]);
+    }
+    marks[mark] = now;
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+/*
+ * Called from the host task for every sample notification handed to the
+ * controller; only the first one per sample is recorded
+ */
+void latency_tx_done(void) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&latency_lock);
+    if (marks[LATENCY_MARK_QUEUED] != 0) {
+        hist_record(LATENCY_STAGE_TX, now - marks[LATENCY_MARK_QUEUED]);
+        hist_record(LATENCY_STAGE_TOTAL, now - marks[LATENCY_MARK_READ_START]);
+        marks[LATENCY_MARK_QUEUED] = 0;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void latency_get_summary(latency_stage_t stage, latency_summary_t* summary) {
+    latency_hist_t h;
+
+    portENTER_CRITICAL(&latency_lock);
+    h = hists[stage];
+    portEXIT_CRITICAL(&latency_lock);
+
+    summary->count = h.count;
+    summary->p50 = hist_percentile(&h, 500);
+    summary->p90 = hist_percentile(&h, 900);
+    summary->p99 = hist_percentile(&h, 990);
+    summary->max = h.max;
+}
+
+/* All stages as packed little endian latency_summary_t, returns bytes written */
+size_t latency_encode(uint8_t* buf, size_t size) {
+    latency_summary_t s;
+    size_t len = 0;
+
+    for (int i = 0; i < LATENCY_STAGE_COUNT && len + LATENCY_SUMMARY_SIZE <= size; i++) {
+        latency_get_summary((latency_stage_t)i, &s);
+        put_le32(buf + len + 0, s.count);
+        put_le32(buf + len + 4, s.p50);
+        put_le32(buf + len + 8, s.p90);
+        put_le32(buf + len + 12, s.p99);
+        put_le32(buf + len + 16, s.max);
+        len += LATENCY_SUMMARY_SIZE;
+    }
+    return len;
+}
+
+void latency_reset(void) {
+    portENTER_CRITICAL(&latency_lock);
+    memset(hists, 0, sizeof(hists));
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void latency_dump(void) {
+    latency_summary_t s;
+
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        latency_get_summary((latency_stage_t)i, &s);
+        ESP_LOGI(LOG_TAG, "%-7s n=%lu p50=%luus p90=%luus p99=%luus max=%luus", stage_names[i], (unsigned long)s.count,
+                 (unsigned long)s.p50, (unsigned long)s.p90, (unsigned long)s.p99, (unsigned long)s.max);
+    }
+}
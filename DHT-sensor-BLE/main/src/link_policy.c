@@ -0,0 +1,151 @@
+/* Includes */
+#include "link_policy.h"
+
+#include <string.h>
+
+/* Private functions */
+static uint16_t ms_to_adv_units(uint32_t ms) {
+    return (uint16_t)(ms * 1000 / 625);
+}
+
+static uint16_t ms_to_conn_units(uint32_t ms) {
+    return (uint16_t)(ms * 4 / 5);
+}
+
+static void set_adv(const link_policy_t* policy, link_action_t* action) {
+    action->start_adv = true;
+    if (policy->adv_mode == LINK_ADV_FAST) {
+        action->adv_itvl_min = ms_to_adv_units(LINK_FAST_ADV_ITVL_MIN_MS);
+        action->adv_itvl_max = ms_to_adv_units(LINK_FAST_ADV_ITVL_MAX_MS);
+        action->adv_duration_ms = LINK_FAST_ADV_DURATION_MS;
+    } else {
+        action->adv_itvl_min = ms_to_adv_units(LINK_SLOW_ADV_ITVL_MIN_MS);
+        action->adv_itvl_max = ms_to_adv_units(LINK_SLOW_ADV_ITVL_MAX_MS);
+        action->adv_duration_ms = LINK_DURATION_FOREVER;
+    }
+}
+
+/* Time between radio wake-ups of a connection, ms */
+static uint32_t wake_period_ms(const link_conn_params_t* params) {
+    return (uint32_t)(params->latency + 1) * params->itvl_max * 5 / 4;
+}
+
+/* Short interval, no latency: the radio is busy anyway during a transfer */
+static void bulk_conn_params(link_conn_params_t* params) {
+    params->itvl_min = 6; /* 7.5 ms, the shortest allowed */
+    params->itvl_max = ms_to_conn_units(LINK_BULK_ITVL_MAX_MS);
+    params->latency = 0;
+    params->supervision_timeout = LINK_BULK_SUPERVISION_TIMEOUT_MS / 10;
+}
+
+/* Public functions */
+void link_policy_init(link_policy_t* policy, uint32_t notify_period_ms) {
+    memset(policy, 0, sizeof(*policy));
+    policy->adv_mode = LINK_ADV_FAST;
+    policy->notify_period_ms = notify_period_ms;
+}
+
+/*
+ * Connection parameters for the current notification period: the
+ * longest interval/latency pair that still wakes up at least once per
+ * notification, with a supervision timeout of three wake periods.
+ */
+void link_policy_conn_params(const link_policy_t* policy, link_conn_params_t* params) {
+    uint32_t period = policy->notify_period_ms;
+    uint32_t itvl = period / (LINK_MAX_LATENCY + 1);
+    uint32_t latency;
+    uint32_t timeout;
+
+    if (itvl < LINK_CONN_ITVL_MIN_MS) {
+        itvl = LINK_CONN_ITVL_MIN_MS;
+    }
+    if (itvl > LINK_CONN_ITVL_MAX_MS) {
+        itvl = LINK_CONN_ITVL_MAX_MS;
+    }
+
+    latency = period / itvl;
+    latency = latency > 0 ? latency - 1 : 0;
+    if (latency > LINK_MAX_LATENCY) {
+        latency = LINK_MAX_LATENCY;
+    }
+
+    timeout = (latency + 1) * itvl * 3;
+    if (timeout < 1000) {
+        timeout = 1000;
+    }
+    if (timeout > LINK_MAX_SUPERVISION_TIMEOUT_MS) {
+        timeout = LINK_MAX_SUPERVISION_TIMEOUT_MS;
+    }
+
+    params->itvl_min = ms_to_conn_units(itvl);
+    params->itvl_max = ms_to_conn_units(itvl);
+    params->latency = (uint16_t)latency;
+    params->supervision_timeout = (uint16_t)(timeout / 10);
+}
+
+void link_policy_handle(link_policy_t* policy, const link_event_t* event, link_action_t* action) {
+    link_conn_params_t wanted;
+
+    memset(action, 0, sizeof(*action));
+
+    switch (event->type) {
+        /* Fast advertising so a central can (re)connect quickly */
+        case LINK_EVT_BOOT:
+        case LINK_EVT_DISCONNECT:
+            policy->adv_mode = LINK_ADV_FAST;
+            set_adv(policy, action);
+            break;
+
+        /* Nobody connected during the fast window, back off */
+        case LINK_EVT_ADV_TIMEOUT:
+            policy->adv_mode = LINK_ADV_SLOW;
+            set_adv(policy, action);
+            break;
+
+        /* Further centrals only need slow advertising */
+        case LINK_EVT_CONNECT:
+            policy->adv_mode = LINK_ADV_SLOW;
+            if (event->slots_free) {
+                set_adv(policy, action);
+            }
+            link_policy_conn_params(policy, &action->conn);
+            action->update_conn = true;
+            break;
+
+        /* Central answered; retry if it is far from what we asked for */
+        case LINK_EVT_CONN_UPDATE:
+            if (event->bulk) {
+                bulk_conn_params(&wanted);
+            } else {
+                link_policy_conn_params(policy, &wanted);
+            }
+            if (event->update_attempts < LINK_MAX_UPDATE_ATTEMPTS) {
+                uint32_t have = wake_period_ms(&event->current);
+                uint32_t want = wake_period_ms(&wanted);
+                if (have < want / 2 || have > want + want / 2) {
+                    action->conn = wanted;
+                    action->update_conn = true;
+                }
+            }
+            break;
+
+        case LINK_EVT_NOTIFY_PERIOD:
+            policy->notify_period_ms = event->notify_period_ms;
+            link_policy_conn_params(policy, &action->conn);
+            action->update_conn = true;
+            break;
+
+        case LINK_EVT_BULK_BEGIN:
+            bulk_conn_params(&action->conn);
+            action->update_conn = true;
+            break;
+
+        case LINK_EVT_BULK_END:
+            link_policy_conn_params(policy, &action->conn);
+            action->update_conn = true;
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,202 @@
+/* Includes */
+#include "sample_codec.h"
+
+#include <string.h>
+
+/* Private functions */
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/* Write the low n bits of v, most significant first */
+static bool put_bits(sample_encoder_t* enc, uint32_t v, unsigned n) {
+    if (enc->bits + n > enc->cap * 8) {
+        return false;
+    }
+    while (n > 0) {
+        size_t byte = enc->bits / 8;
+        unsigned free_bits = 8 - (unsigned)(enc->bits % 8);
+        unsigned take = n < free_bits ? n : free_bits;
+        uint8_t part = (uint8_t)((v >> (n - take)) & ((1u << take) - 1));
+        /* Bits already written; the rest may hold leftovers of a rolled back put */
+        uint8_t keep = (uint8_t)(0xFF << free_bits);
+
+        enc->buf[byte] = (uint8_t)((enc->buf[byte] & keep) | (part << (free_bits - take)));
+        enc->bits += take;
+        n -= take;
+    }
+    return true;
+}
+
+static bool get_bits(sample_decoder_t* dec, unsigned n, uint32_t* v) {
+    uint32_t result = 0;
+
+    if (dec->bits + n > dec->len * 8) {
+        return false;
+    }
+    while (n > 0) {
+        unsigned avail = 8 - (unsigned)(dec->bits % 8);
+        unsigned take = n < avail ? n : avail;
+        uint8_t byte = dec->buf[dec->bits / 8];
+
+        result = (result << take) | ((uint32_t)(byte >> (avail - take)) & ((1u << take) - 1));
+        dec->bits += take;
+        n -= take;
+    }
+    *v = result;
+    return true;
+}
+
+/* Count leading one bits of a prefix code, up to max */
+static bool get_prefix(sample_decoder_t* dec, unsigned max, unsigned* ones) {
+    uint32_t bit;
+
+    *ones = 0;
+    while (*ones < max) {
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            break;
+        }
+        (*ones)++;
+    }
+    return true;
+}
+
+static bool put_interval(sample_encoder_t* enc, int32_t dod) {
+    uint32_t z = zigzag(dod);
+
+    if (dod == 0) {
+        return put_bits(enc, 0x0, 1);
+    }
+    if (z < (1u << 7)) {
+        return put_bits(enc, 0x2, 2) && put_bits(enc, z, 7);
+    }
+    if (z < (1u << 12)) {
+        return put_bits(enc, 0x6, 3) && put_bits(enc, z, 12);
+    }
+    if (z < (1u << 20)) {
+        return put_bits(enc, 0xE, 4) && put_bits(enc, z, 20);
+    }
+    return put_bits(enc, 0xF, 4) && put_bits(enc, z, 32);
+}
+
+static bool put_value(sample_encoder_t* enc, uint16_t value, uint16_t prev) {
+    int32_t delta = (int32_t)(int16_t)(uint16_t)(value - prev);
+    uint32_t z = zigzag(delta);
+
+    if (delta == 0) {
+        return put_bits(enc, 0x0, 1);
+    }
+    if (z < (1u << 3)) {
+        return put_bits(enc, 0x2, 2) && put_bits(enc, z, 3);
+    }
+    if (z < (1u << 7)) {
+        return put_bits(enc, 0x6, 3) && put_bits(enc, z, 7);
+    }
+    return put_bits(enc, 0x7, 3) && put_bits(enc, value, 16);
+}
+
+static bool get_value(sample_decoder_t* dec, uint16_t prev, uint16_t* value) {
+    static const unsigned widths[] = {0, 3, 7};
+    unsigned ones;
+    uint32_t v;
+
+    if (!get_prefix(dec, 3, &ones)) {
+        return false;
+    }
+    if (ones == 0) {
+        *value = prev;
+        return true;
+    }
+    if (ones == 3) {
+        if (!get_bits(dec, 16, &v)) {
+            return false;
+        }
+        *value = (uint16_t)v;
+        return true;
+    }
+    if (!get_bits(dec, widths[ones], &v)) {
+        return false;
+    }
+    *value = (uint16_t)(prev + unzigzag(v));
+    return true;
+}
+
+/* Public functions */
+void sample_encoder_init(sample_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t base_timestamp) {
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->prev.timestamp = base_timestamp;
+}
+
+bool sample_encoder_put(sample_encoder_t* enc, const sample_t* sample) {
+    sample_encoder_t saved = *enc;
+    int32_t interval = (int32_t)(sample->timestamp - enc->prev.timestamp);
+
+    if (!put_interval(enc, interval - enc->prev.interval) ||
+        !put_value(enc, (uint16_t)sample->temperature, (uint16_t)enc->prev.temperature) ||
+        !put_value(enc, sample->humidity, enc->prev.humidity)) {
+        *enc = saved;
+        return false;
+    }
+
+    enc->prev.timestamp = sample->timestamp;
+    enc->prev.interval = interval;
+    enc->prev.temperature = sample->temperature;
+    enc->prev.humidity = sample->humidity;
+    enc->count++;
+    return true;
+}
+
+size_t sample_encoder_bytes(const sample_encoder_t* enc) {
+    return (enc->bits + 7) / 8;
+}
+
+void sample_decoder_init(sample_decoder_t* dec, const uint8_t* buf, size_t len, uint32_t base_timestamp, uint16_t count) {
+    memset(dec, 0, sizeof(*dec));
+    dec->buf = buf;
+    dec->len = len;
+    dec->left = count;
+    dec->prev.timestamp = base_timestamp;
+}
+
+bool sample_decoder_next(sample_decoder_t* dec, sample_t* sample) {
+    static const unsigned widths[] = {0, 7, 12, 20, 32};
+    unsigned ones;
+    uint32_t v;
+    int32_t dod = 0;
+    uint16_t temperature;
+    uint16_t humidity;
+
+    if (dec->left == 0 || !get_prefix(dec, 4, &ones)) {
+        return false;
+    }
+    if (ones > 0) {
+        if (!get_bits(dec, widths[ones], &v)) {
+            return false;
+        }
+        dod = unzigzag(v);
+    }
+    if (!get_value(dec, (uint16_t)dec->prev.temperature, &temperature) || !get_value(dec, dec->prev.humidity, &humidity)) {
+        return false;
+    }
+
+    dec->prev.interval += dod;
+    dec->prev.timestamp += (uint32_t)dec->prev.interval;
+    dec->prev.temperature = (int16_t)temperature;
+    dec->prev.humidity = humidity;
+    dec->left--;
+
+    sample->seq = 0; /* not part of the stream */
+    sample->timestamp = dec->prev.timestamp;
+    sample->temperature = dec->prev.temperature;
+    sample->humidity = dec->prev.humidity;
+    return true;
+}
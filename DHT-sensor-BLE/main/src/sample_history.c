@@ -0,0 +1,213 @@
+/* Includes */
+#include "sample_history.h"
+
+#include <string.h>
+
+/* ESP APIs */
+#include "esp_timer.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+
+/* Private types */
+typedef struct {
+    int32_t temperature_sum;
+    int32_t humidity_sum;
+    uint16_t count;
+    int16_t temperature_min;
+    int16_t temperature_max;
+    uint16_t humidity_min;
+    uint16_t humidity_max;
+} bucket_t;
+
+/*
+ * A window is split into SAMPLE_WINDOW_BUCKETS buckets. Sums are kept as
+ * running totals, min/max of the closed buckets are recomputed only when
+ * the current bucket rolls over, so a push is O(1) for the sums and
+ * O(SAMPLE_WINDOW_BUCKETS) at most once per bucket for min/max.
+ */
+typedef struct {
+    uint32_t bucket_secs;
+    uint32_t bucket_start;
+    uint8_t cur;
+    bucket_t buckets[SAMPLE_WINDOW_BUCKETS];
+    int32_t temperature_sum;
+    int32_t humidity_sum;
+    uint32_t count;
+    bucket_t closed; /* min/max over all buckets except the current one */
+    sample_agg_t agg;
+} window_t;
+
+/* Private variables */
+static sample_t samples[SAMPLE_HISTORY_LEN];
+static uint32_t next_seq = 0;
+static uint32_t time_base = 0;
+static window_t windows[SAMPLE_WINDOW_COUNT];
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Private functions */
+static void bucket_clear(bucket_t* b) {
+    memset(b, 0, sizeof(*b));
+    b->temperature_min = INT16_MAX;
+    b->temperature_max = INT16_MIN;
+    b->humidity_min = UINT16_MAX;
+    b->humidity_max = 0;
+}
+
+static void bucket_merge_minmax(bucket_t* dst, const bucket_t* src) {
+    if (src->count == 0) {
+        return;
+    }
+    if (src->temperature_min < dst->temperature_min) dst->temperature_min = src->temperature_min;
+    if (src->temperature_max > dst->temperature_max) dst->temperature_max = src->temperature_max;
+    if (src->humidity_min < dst->humidity_min) dst->humidity_min = src->humidity_min;
+    if (src->humidity_max > dst->humidity_max) dst->humidity_max = src->humidity_max;
+    dst->count += src->count;
+}
+
+static void window_reset(window_t* w, uint32_t secs, uint32_t now) {
+    memset(w, 0, sizeof(*w));
+    w->bucket_secs = secs / SAMPLE_WINDOW_BUCKETS;
+    w->bucket_start = now - now % w->bucket_secs;
+    for (int i = 0; i < SAMPLE_WINDOW_BUCKETS; i++) {
+        bucket_clear(&w->buckets[i]);
+    }
+    bucket_clear(&w->closed);
+}
+
+static void window_advance(window_t* w, uint32_t now) {
+    uint32_t elapsed = (now - w->bucket_start) / w->bucket_secs;
+    if (elapsed == 0) {
+        return;
+    }
+
+    /* Long outage: everything in the window has expired */
+    if (elapsed >= SAMPLE_WINDOW_BUCKETS) {
+        window_reset(w, w->bucket_secs * SAMPLE_WINDOW_BUCKETS, now);
+        return;
+    }
+
+    for (uint32_t i = 0; i < elapsed; i++) {
+        w->cur = (w->cur + 1) % SAMPLE_WINDOW_BUCKETS;
+        bucket_t* old = &w->buckets[w->cur];
+        w->temperature_sum -= old->temperature_sum;
+        w->humidity_sum -= old->humidity_sum;
+        w->count -= old->count;
+        bucket_clear(old);
+    }
+    w->bucket_start += elapsed * w->bucket_secs;
+
+    bucket_clear(&w->closed);
+    for (int i = 0; i < SAMPLE_WINDOW_BUCKETS; i++) {
+        if (i != w->cur) {
+            bucket_merge_minmax(&w->closed, &w->buckets[i]);
+        }
+    }
+}
+
+static void window_update_agg(window_t* w) {
+    bucket_t all = w->closed;
+
+    if (w->count == 0) {
+        memset(&w->agg, 0, sizeof(w->agg));
+        return;
+    }
+    bucket_merge_minmax(&all, &w->buckets[w->cur]);
+    w->agg.count = (uint16_t)(w->count > UINT16_MAX ? UINT16_MAX : w->count);
+    w->agg.temperature_min = all.temperature_min;
+    w->agg.temperature_max = all.temperature_max;
+    w->agg.temperature_mean = (int16_t)(w->temperature_sum / (int32_t)w->count);
+    w->agg.humidity_min = all.humidity_min;
+    w->agg.humidity_max = all.humidity_max;
+    w->agg.humidity_mean = (uint16_t)(w->humidity_sum / (int32_t)w->count);
+}
+
+static void window_add(window_t* w, uint32_t now, int16_t temperature, uint16_t humidity) {
+    window_advance(w, now);
+
+    bucket_t* b = &w->buckets[w->cur];
+    bucket_t one = {.count = 1,
+                    .temperature_min = temperature,
+                    .temperature_max = temperature,
+                    .humidity_min = humidity,
+                    .humidity_max = humidity};
+    bucket_merge_minmax(b, &one);
+    b->temperature_sum += temperature;
+    b->humidity_sum += humidity;
+
+    w->temperature_sum += temperature;
+    w->humidity_sum += humidity;
+    w->count++;
+
+    window_update_agg(w);
+}
+
+/* Public functions */
+void sample_history_init(void) {
+    portENTER_CRITICAL(&history_lock);
+    next_seq = 0;
+    memset(samples, 0, sizeof(samples));
+    window_reset(&windows[SAMPLE_WINDOW_SHORT], SAMPLE_WINDOW_SHORT_SECS, 0);
+    window_reset(&windows[SAMPLE_WINDOW_LONG], SAMPLE_WINDOW_LONG_SECS, 0);
+    portEXIT_CRITICAL(&history_lock);
+}
+
+void sample_history_set_time_base(uint32_t base) {
+    time_base = base;
+}
+
+uint32_t sample_history_now(void) {
+    return time_base + (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+uint32_t sample_history_push(uint32_t timestamp, int16_t temperature, uint16_t humidity) {
+    portENTER_CRITICAL(&history_lock);
+    uint32_t seq = next_seq++;
+    sample_t* s = &samples[seq % SAMPLE_HISTORY_LEN];
+    s->seq = seq;
+    s->timestamp = timestamp;
+    s->temperature = temperature;
+    s->humidity = humidity;
+    for (int i = 0; i < SAMPLE_WINDOW_COUNT; i++) {
+        window_add(&windows[i], timestamp, temperature, humidity);
+    }
+    portEXIT_CRITICAL(&history_lock);
+    return seq;
+}
+
+/* Buckets that went quiet since the last push expire here, not only on the next push */
+void sample_history_get_agg(sample_window_id_t window, uint32_t now, sample_agg_t* agg) {
+    portENTER_CRITICAL(&history_lock);
+    window_advance(&windows[window], now);
+    window_update_agg(&windows[window]);
+    *agg = windows[window].agg;
+    portEXIT_CRITICAL(&history_lock);
+}
+
+/*
+ * Copy up to max samples starting at seq. If seq has already been
+ * overwritten, start from the oldest sample still in the buffer, so a
+ * client that reconnects after an outage resumes from what is left.
+ */
+size_t sample_history_read_since(uint32_t seq, sample_t* out, size_t max) {
+    size_t n = 0;
+
+    portENTER_CRITICAL(&history_lock);
+    uint32_t oldest = next_seq > SAMPLE_HISTORY_LEN ? next_seq - SAMPLE_HISTORY_LEN : 0;
+    if (seq < oldest) {
+        seq = oldest;
+    }
+    while (seq < next_seq && n < max) {
+        out[n++] = samples[seq % SAMPLE_HISTORY_LEN];
+        seq++;
+    }
+    portEXIT_CRITICAL(&history_lock);
+    return n;
+}
+
+uint32_t sample_history_next_seq(void) {
+    portENTER_CRITICAL(&history_lock);
+    uint32_t seq = next_seq;
+    portEXIT_CRITICAL(&history_lock);
+    return seq;
+}
@@ -0,0 +1,158 @@
+/* Includes */
+#include "sampler.h"
+
+#include <stdint.h>
+
+/* ESP APIs */
+#include "esp_timer.h"
+
+/* Wake window grid */
+#include "duty_cycle.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Defines */
+#define MS_TO_US(ms) ((int64_t)(ms) * 1000)
+
+/* Private variables */
+static TaskHandle_t measure_task = NULL;
+static portMUX_TYPE sampler_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Guarded by sampler_lock */
+static bool periodic = false;
+static bool background = false;
+static bool demand = false;
+static bool flush_log = false;
+static bool read_done = false;
+static bool reading = false;
+static int64_t last_read_us = 0;
+static int64_t last_ok_us = 0;
+
+/* Private functions */
+static TickType_t us_to_ticks(int64_t us) {
+    TickType_t ticks = pdMS_TO_TICKS((us + 999) / 1000);
+    return ticks > 0 ? ticks : 1;
+}
+
+static void kick(void) {
+    if (measure_task != NULL) {
+        xTaskNotifyGive(measure_task);
+    }
+}
+
+/* Public functions */
+void sampler_init(void) {
+    portENTER_CRITICAL(&sampler_lock);
+    periodic = false;
+    background = false;
+    demand = false;
+    flush_log = false;
+    read_done = false;
+    reading = false;
+    last_read_us = 0;
+    last_ok_us = 0;
+    portEXIT_CRITICAL(&sampler_lock);
+}
+
+sampler_job_t sampler_wait(void) {
+    measure_task = xTaskGetCurrentTaskHandle();
+
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        int64_t earliest;
+        int64_t next_periodic;
+        bool due;
+        TickType_t wait;
+
+        portENTER_CRITICAL(&sampler_lock);
+        if (flush_log) {
+            flush_log = false;
+            portEXIT_CRITICAL(&sampler_lock);
+            return SAMPLER_JOB_FLUSH_LOG;
+        }
+        earliest = read_done ? last_read_us + MS_TO_US(SAMPLER_MIN_INTERVAL_MS) : 0;
+        /* Periodic reads land on the wake window grid, and never before the sensor allows */
+        next_periodic = read_done ? duty_cycle_align_us(earliest) : now;
+        due = demand || ((periodic || background) && now >= next_periodic);
+        if (due && now >= earliest) {
+            demand = false;
+            read_done = true;
+            reading = true;
+            last_read_us = now;
+            portEXIT_CRITICAL(&sampler_lock);
+            return SAMPLER_JOB_READ;
+        }
+        if (due) {
+            wait = us_to_ticks(earliest - now);
+        } else if (periodic || background) {
+            wait = us_to_ticks(next_periodic - now);
+        } else {
+            wait = portMAX_DELAY;
+        }
+        portEXIT_CRITICAL(&sampler_lock);
+
+        /* Woken early by a sampling mode change, a stale read or a flush request */
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+void sampler_done(bool ok) {
+    portENTER_CRITICAL(&sampler_lock);
+    reading = false;
+    if (ok) {
+        last_ok_us = last_read_us;
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+}
+
+void sampler_set_periodic(bool enabled) {
+    bool changed;
+
+    portENTER_CRITICAL(&sampler_lock);
+    changed = periodic != enabled;
+    periodic = enabled;
+    portEXIT_CRITICAL(&sampler_lock);
+
+    if (changed) {
+        kick();
+    }
+}
+
+void sampler_set_background(bool enabled) {
+    bool changed;
+
+    portENTER_CRITICAL(&sampler_lock);
+    changed = background != enabled;
+    background = enabled;
+    portEXIT_CRITICAL(&sampler_lock);
+
+    if (changed) {
+        kick();
+    }
+}
+
+void sampler_refresh(void) {
+    int64_t now = esp_timer_get_time();
+    bool stale;
+
+    portENTER_CRITICAL(&sampler_lock);
+    stale = last_ok_us == 0 || now - last_ok_us >= MS_TO_US(SAMPLER_TTL_MS);
+    /* A read already running will refresh it; sampler_wait holds back one inside the minimum interval */
+    if (stale && !reading) {
+        demand = true;
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+
+    if (stale) {
+        kick();
+    }
+}
+
+void sampler_request_flush(void) {
+    portENTER_CRITICAL(&sampler_lock);
+    flush_log = true;
+    portEXIT_CRITICAL(&sampler_lock);
+    kick();
+}
@@ -0,0 +1,424 @@
+/* Includes */
+#include "sensor_log.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* ESP APIs */
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+/* Sample codec */
+#include "sample_codec.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/* Defines */
+#define LOG_TAG "SensorLog"
+#define CHUNK_MAGIC 0x4C48
+
+/*
+ * Chunk layout, little endian
+ *   uint16 magic, uint16 payload length, uint32 chunk sequence,
+ *   uint32 timestamp of the first sample, uint16 sample count,
+ *   uint16 CRC-16 over the header (without CRC) and the payload
+ * followed by the payload: the samples encoded with sample_codec, starting
+ * from the first timestamp
+ */
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint32_t seq;
+    uint32_t first_ts;
+    uint16_t count;
+    uint16_t crc;
+} chunk_header_t;
+
+/* Private variables */
+static const esp_partition_t* log_part = NULL;
+static uint32_t sector_count = 0;
+static uint32_t head_sector = 0;
+static uint32_t head_slot = 0;
+static uint32_t next_chunk_seq = 0;
+static uint32_t last_timestamp = 0;
+static SemaphoreHandle_t log_mutex = NULL;
+
+/* Sector erased ahead for the head to move into, only touched by the writer task */
+static uint32_t erased_sector = UINT32_MAX;
+
+/* Chunk being filled in RAM */
+static uint8_t chunk_buf[SENSOR_LOG_CHUNK_SIZE];
+static sample_encoder_t chunk_enc;
+static uint32_t chunk_first_ts = 0;
+
+/* Private functions */
+static void header_encode(const chunk_header_t* h, uint8_t* p) {
+    p[0] = (uint8_t)h->magic;
+    p[1] = (uint8_t)(h->magic >> 8);
+    p[2] = (uint8_t)h->len;
+    p[3] = (uint8_t)(h->len >> 8);
+    for (int i = 0; i < 4; i++) {
+        p[4 + i] = (uint8_t)(h->seq >> (8 * i));
+        p[8 + i] = (uint8_t)(h->first_ts >> (8 * i));
+    }
+    p[12] = (uint8_t)h->count;
+    p[13] = (uint8_t)(h->count >> 8);
+    p[14] = (uint8_t)h->crc;
+    p[15] = (uint8_t)(h->crc >> 8);
+}
+
+static void header_decode(const uint8_t* p, chunk_header_t* h) {
+    h->magic = (uint16_t)(p[0] | (p[1] << 8));
+    h->len = (uint16_t)(p[2] | (p[3] << 8));
+    h->seq = 0;
+    h->first_ts = 0;
+    for (int i = 0; i < 4; i++) {
+        h->seq |= (uint32_t)p[4 + i] << (8 * i);
+        h->first_ts |= (uint32_t)p[8 + i] << (8 * i);
+    }
+    h->count = (uint16_t)(p[12] | (p[13] << 8));
+    h->crc = (uint16_t)(p[14] | (p[15] << 8));
+}
+
+static uint16_t chunk_crc(const uint8_t* chunk, size_t payload_len) {
+    uint16_t crc = esp_crc16_le(0, chunk, SENSOR_LOG_CHUNK_HEADER_SIZE - 2);
+    return esp_crc16_le(crc, chunk + SENSOR_LOG_CHUNK_HEADER_SIZE, payload_len);
+}
+
+static size_t chunk_offset(uint32_t sector, uint32_t slot) {
+    return (size_t)sector * SENSOR_LOG_SECTOR_SIZE + (size_t)slot * SENSOR_LOG_CHUNK_SIZE;
+}
+
+/* Read and validate a whole chunk; false for erased, torn or foreign data */
+static bool chunk_read(uint32_t sector, uint32_t slot, uint8_t* chunk, chunk_header_t* h) {
+    if (esp_partition_read(log_part, chunk_offset(sector, slot), chunk, SENSOR_LOG_CHUNK_SIZE) != ESP_OK) {
+        return false;
+    }
+    header_decode(chunk, h);
+    if (h->magic != CHUNK_MAGIC || h->len > SENSOR_LOG_CHUNK_PAYLOAD_MAX) {
+        return false;
+    }
+    return chunk_crc(chunk, h->len) == h->crc;
+}
+
+static bool slot_erased(uint32_t sector, uint32_t slot) {
+    uint8_t raw[SENSOR_LOG_CHUNK_HEADER_SIZE];
+    if (esp_partition_read(log_part, chunk_offset(sector, slot), raw, sizeof(raw)) != ESP_OK) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        if (raw[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* First valid chunk header of a sector */
+static bool sector_first(uint32_t sector, chunk_header_t* h) {
+    uint8_t chunk[SENSOR_LOG_CHUNK_SIZE];
+    for (uint32_t slot = 0; slot < SENSOR_LOG_CHUNKS_PER_SECTOR; slot++) {
+        if (chunk_read(sector, slot, chunk, h)) {
+            return true;
+        }
+        if (slot_erased(sector, slot)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static void chunk_reset(uint32_t first_ts) {
+    chunk_first_ts = first_ts;
+    sample_encoder_init(&chunk_enc, chunk_buf + SENSOR_LOG_CHUNK_HEADER_SIZE, SENSOR_LOG_CHUNK_PAYLOAD_MAX, first_ts);
+}
+
+/* Write the RAM chunk to the head slot; must be called with log_mutex held */
+static esp_err_t chunk_write(void) {
+    esp_err_t err;
+    size_t chunk_len = sample_encoder_bytes(&chunk_enc);
+    chunk_header_t h = {.magic = CHUNK_MAGIC,
+                        .len = (uint16_t)chunk_len,
+                        .seq = next_chunk_seq,
+                        .first_ts = chunk_first_ts,
+                        .count = chunk_enc.count};
+
+    if (chunk_enc.count == 0) {
+        return ESP_OK;
+    }
+
+    /* Starting a sector that was not erased ahead: erase it now, dropping the oldest data */
+    if (head_slot == 0 && head_sector != erased_sector) {
+        err = esp_partition_erase_range(log_part, chunk_offset(head_sector, 0), SENSOR_LOG_SECTOR_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    memset(chunk_buf + SENSOR_LOG_CHUNK_HEADER_SIZE + chunk_len, 0xFF, SENSOR_LOG_CHUNK_PAYLOAD_MAX - chunk_len);
+    header_encode(&h, chunk_buf);
+    h.crc = chunk_crc(chunk_buf, chunk_len);
+    header_encode(&h, chunk_buf);
+
+    err = esp_partition_write(log_part, chunk_offset(head_sector, head_slot), chunk_buf, SENSOR_LOG_CHUNK_SIZE);
+
+    /* A failed write still consumes the slot, recovery skips it */
+    next_chunk_seq++;
+    if (++head_slot == SENSOR_LOG_CHUNKS_PER_SECTOR) {
+        head_slot = 0;
+        head_sector = (head_sector + 1) % sector_count;
+    }
+    chunk_reset(0);
+    return err;
+}
+
+/*
+ * One chunk before the head leaves its sector, erase the next one; after
+ * boot, erase the head sector if nothing has been written to it yet. This
+ * runs without log_mutex, so a history transfer does not wait on the lock
+ * for the tens of ms an erase takes; the oldest sector simply reads as
+ * empty once it is gone. Writer task only.
+ */
+static void erase_ahead(void) {
+    esp_err_t err;
+    uint32_t sector;
+
+    if (head_slot == 0) {
+        sector = head_sector;
+    } else if (head_slot == SENSOR_LOG_CHUNKS_PER_SECTOR - 1 && sector_count > 1) {
+        sector = (head_sector + 1) % sector_count;
+    } else {
+        return;
+    }
+    if (sector == erased_sector) {
+        return;
+    }
+    err = esp_partition_erase_range(log_part, chunk_offset(sector, 0), SENSOR_LOG_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        /* chunk_write erases it when it gets there */
+        ESP_LOGE(LOG_TAG, "failed to erase sector %lu ahead, error code: %d", (unsigned long)sector, err);
+        return;
+    }
+    erased_sector = sector;
+}
+
+/* Public functions */
+esp_err_t sensor_log_init(void) {
+    /* Local variables */
+    uint8_t chunk[SENSOR_LOG_CHUNK_SIZE];
+    chunk_header_t h;
+    sample_decoder_t dec;
+    sample_t sample;
+    bool found = false;
+    uint32_t max_seq = 0;
+
+    log_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SENSOR_LOG_PARTITION_LABEL);
+    if (log_part == NULL) {
+        ESP_LOGE(LOG_TAG, "partition %s not found", SENSOR_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    sector_count = log_part->size / SENSOR_LOG_SECTOR_SIZE;
+    log_mutex = xSemaphoreCreateMutex();
+    erased_sector = UINT32_MAX;
+    chunk_reset(0);
+
+    /* Head sector is the one whose first chunk has the highest sequence */
+    for (uint32_t s = 0; s < sector_count; s++) {
+        if (sector_first(s, &h) && (!found || h.seq > max_seq)) {
+            found = true;
+            max_seq = h.seq;
+            head_sector = s;
+        }
+    }
+    if (!found) {
+        head_sector = 0;
+        head_slot = 0;
+        erase_ahead();
+        ESP_LOGI(LOG_TAG, "empty log, %lu sectors", (unsigned long)sector_count);
+        return ESP_OK;
+    }
+
+    /* Find the first erased slot, remember the newest valid chunk */
+    head_slot = SENSOR_LOG_CHUNKS_PER_SECTOR;
+    for (uint32_t slot = 0; slot < SENSOR_LOG_CHUNKS_PER_SECTOR; slot++) {
+        if (chunk_read(head_sector, slot, chunk, &h)) {
+            if (h.seq >= max_seq) {
+                max_seq = h.seq;
+                sensor_log_chunk_decoder(chunk, SENSOR_LOG_CHUNK_SIZE, &dec);
+                while (sample_decoder_next(&dec, &sample)) {
+                    last_timestamp = sample.timestamp;
+                }
+            }
+        } else if (slot_erased(head_sector, slot)) {
+            head_slot = slot;
+            break;
+        }
+    }
+    if (head_slot == SENSOR_LOG_CHUNKS_PER_SECTOR) {
+        head_slot = 0;
+        head_sector = (head_sector + 1) % sector_count;
+    }
+    next_chunk_seq = max_seq + 1;
+    erase_ahead();
+
+    ESP_LOGI(LOG_TAG, "recovered log head sector=%lu slot=%lu seq=%lu last_ts=%lu", (unsigned long)head_sector,
+             (unsigned long)head_slot, (unsigned long)next_chunk_seq, (unsigned long)last_timestamp);
+    return ESP_OK;
+}
+
+esp_err_t sensor_log_append(const sample_t* sample) {
+    /* Local variables */
+    esp_err_t err = ESP_OK;
+
+    if (log_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    if (chunk_enc.count == 0) {
+        chunk_reset(sample->timestamp);
+    }
+
+    /* Chunk full: write it out and start the next one with this sample */
+    if (!sample_encoder_put(&chunk_enc, sample)) {
+        err = chunk_write();
+        xSemaphoreGive(log_mutex);
+        if (err != ESP_OK) {
+            ESP_LOGE(LOG_TAG, "failed to write chunk, error code: %d", err);
+        }
+        erase_ahead();
+        return sensor_log_append(sample);
+    }
+
+    last_timestamp = sample->timestamp;
+
+    xSemaphoreGive(log_mutex);
+    return err;
+}
+
+/* Write the partially filled chunk, e.g. before a download or sleep */
+esp_err_t sensor_log_flush(void) {
+    esp_err_t err;
+
+    if (log_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    err = chunk_write();
+    xSemaphoreGive(log_mutex);
+    erase_ahead();
+    return err;
+}
+
+uint32_t sensor_log_last_timestamp(void) {
+    return last_timestamp;
+}
+
+esp_err_t sensor_log_seek(uint32_t timestamp, sensor_log_cursor_t* cursor) {
+    /* Local variables */
+    uint8_t chunk[SENSOR_LOG_CHUNK_SIZE];
+    chunk_header_t h;
+    uint32_t lo = 0;
+    uint32_t hi;
+    uint32_t sector;
+
+    if (log_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    /*
+     * Logical sector i is (head_sector + 1 + i) % sector_count, the head
+     * sector being the last one. Find the last sector whose first chunk
+     * starts at or before timestamp; empty sectors sort first.
+     */
+    hi = sector_count - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        sector = (head_sector + 1 + mid) % sector_count;
+        if (!sector_first(sector, &h) || h.first_ts <= timestamp) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    sector = (head_sector + 1 + lo) % sector_count;
+    if (!sector_first(sector, &h)) {
+        /* Everything is newer than timestamp: start at the oldest data */
+        for (uint32_t i = 0; i < sector_count; i++) {
+            sector = (head_sector + 1 + i) % sector_count;
+            if (sector_first(sector, &h)) {
+                break;
+            }
+        }
+    }
+
+    /* Last chunk in the sector starting at or before timestamp */
+    cursor->sector = sector;
+    cursor->slot = 0;
+    for (uint32_t slot = 0; slot < SENSOR_LOG_CHUNKS_PER_SECTOR; slot++) {
+        if (sector == head_sector && slot == head_slot) {
+            break;
+        }
+        if (chunk_read(sector, slot, chunk, &h)) {
+            if (h.first_ts > timestamp) {
+                break;
+            }
+            cursor->slot = slot;
+        }
+    }
+
+    xSemaphoreGive(log_mutex);
+    return ESP_OK;
+}
+
+esp_err_t sensor_log_next_chunk(sensor_log_cursor_t* cursor, uint8_t* chunk, size_t* len) {
+    /* Local variables */
+    chunk_header_t h;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (log_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    while (!(cursor->sector == head_sector && cursor->slot == head_slot)) {
+        bool valid = chunk_read(cursor->sector, cursor->slot, chunk, &h);
+        bool erased = !valid && slot_erased(cursor->sector, cursor->slot);
+
+        if (++cursor->slot == SENSOR_LOG_CHUNKS_PER_SECTOR || erased) {
+            /* Rest of a sector is erased when it was flushed early */
+            cursor->slot = 0;
+            cursor->sector = (cursor->sector + 1) % sector_count;
+        }
+        if (valid) {
+            *len = SENSOR_LOG_CHUNK_HEADER_SIZE + h.len;
+            err = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(log_mutex);
+    return err;
+}
+
+/* Set up a decoder over the samples of a raw chunk */
+bool sensor_log_chunk_decoder(const uint8_t* chunk, size_t len, sample_decoder_t* dec) {
+    /* Local variables */
+    chunk_header_t h;
+
+    if (len < SENSOR_LOG_CHUNK_HEADER_SIZE) {
+        return false;
+    }
+    header_decode(chunk, &h);
+    if (h.magic != CHUNK_MAGIC || h.len > len - SENSOR_LOG_CHUNK_HEADER_SIZE) {
+        sample_decoder_init(dec, NULL, 0, 0, 0);
+        return false;
+    }
+    sample_decoder_init(dec, chunk + SENSOR_LOG_CHUNK_HEADER_SIZE, h.len, h.first_ts, h.count);
+    return true;
+}
@@ -0,0 +1,215 @@
+/*
+ * Pusta snimljene bridove (corpus/frames.txt) kroz dht_decode_edges.
+ *
+ * Za svaki okvir provjerava rezultat prema klasi iz korpusa i na kraju
+ * ispisuje broj gresaka po klasi te brzinu dekodiranja. Izlazni kod je
+ * 1 ako ijedan okvir nije dekodiran kako treba, pa se moze koristiti kao
+ * regresijski test.
+ *
+ *   dht_decode_replay <frames.txt> [ponavljanja]
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dht_decode.h"
+
+#define MAX_FRAMES 1024
+#define MAX_EDGES 128
+#define DEFAULT_REPEAT 2000
+
+typedef enum
+{
+    CLASS_OK = 0,
+    CLASS_CRC,
+    CLASS_BAD,
+    CLASS_NONE,
+    CLASS_COUNT,
+} frame_class_t;
+
+static const char *const class_names[CLASS_COUNT] = {"ok", "crc", "bad", "none"};
+
+typedef struct
+{
+    frame_class_t cls;
+    unsigned line;
+    uint8_t data[DHT_DATA_BYTES];
+    size_t count;
+    dht_edge_t edges[MAX_EDGES];
+} frame_t;
+
+static frame_t frames[MAX_FRAMES];
+
+static int parse_class(const char *name)
+{
+    for (int i = 0; i < CLASS_COUNT; i++)
+    {
+        if (strcmp(name, class_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int parse_line(char *line, frame_t *frame)
+{
+    char *save = NULL;
+    char *tok = strtok_r(line, " \t\r\n", &save);
+    int cls = tok ? parse_class(tok) : -1;
+    if (cls < 0)
+        return -1;
+    frame->cls = (frame_class_t)cls;
+
+    // tip se ne koristi za dekodiranje, samo za citljivost korpusa
+    if (!strtok_r(NULL, " \t\r\n", &save))
+        return -1;
+
+    tok = strtok_r(NULL, " \t\r\n", &save);
+    if (!tok || strlen(tok) != 2 * DHT_DATA_BYTES)
+        return -1;
+    for (size_t i = 0; i < DHT_DATA_BYTES; i++)
+    {
+        unsigned byte;
+        if (sscanf(tok + 2 * i, "%2x", &byte) != 1)
+            return -1;
+        frame->data[i] = (uint8_t)byte;
+    }
+
+    tok = strtok_r(NULL, " \t\r\n", &save);
+    unsigned long count = tok ? strtoul(tok, NULL, 10) : MAX_EDGES + 1;
+    if (count > MAX_EDGES)
+        return -1;
+
+    for (frame->count = 0; frame->count < count; frame->count++)
+    {
+        unsigned long time_us;
+        unsigned level;
+        tok = strtok_r(NULL, " \t\r\n", &save);
+        if (!tok || sscanf(tok, "%lu:%u", &time_us, &level) != 2)
+            return -1;
+        frame->edges[frame->count].time_us = (uint32_t)time_us;
+        frame->edges[frame->count].level = (uint8_t)level;
+    }
+    return 0;
+}
+
+static size_t load_corpus(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    static char line[16384];
+    size_t n = 0;
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (n >= MAX_FRAMES)
+        {
+            fprintf(stderr, "%s: more than %d frames\n", path, MAX_FRAMES);
+            exit(2);
+        }
+        frames[n].line = line_no;
+        if (parse_line(line, &frames[n]) != 0)
+        {
+            fprintf(stderr, "%s:%u: bad frame\n", path, line_no);
+            exit(2);
+        }
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static bool decoded_as_expected(const frame_t *frame, dht_decode_err_t err, const uint8_t *data)
+{
+    switch (frame->cls)
+    {
+    case CLASS_OK:
+        return err == DHT_DECODE_OK && memcmp(data, frame->data, DHT_DATA_BYTES) == 0;
+    case CLASS_CRC:
+        return err == DHT_DECODE_ERR_CHECKSUM;
+    case CLASS_BAD:
+        // smije se i dekodirati ako je izgubljeni brid bio nebitan, ali ne u krive bajtove
+        return err != DHT_DECODE_OK || memcmp(data, frame->data, DHT_DATA_BYTES) == 0;
+    default:
+        return err == DHT_DECODE_ERR_SHORT;
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <frames.txt> [repeat]\n", argv[0]);
+        return 2;
+    }
+    size_t count = load_corpus(argv[1]);
+    unsigned long repeat = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_REPEAT;
+
+    // tocnost: svaki okvir jednom
+    unsigned frames_per_class[CLASS_COUNT] = {0};
+    unsigned errors_per_class[CLASS_COUNT] = {0};
+    unsigned errors = 0;
+    size_t edges = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t data[DHT_DATA_BYTES];
+        dht_decode_err_t err = dht_decode_edges(frames[i].edges, frames[i].count, data);
+
+        frames_per_class[frames[i].cls]++;
+        edges += frames[i].count;
+        if (!decoded_as_expected(&frames[i], err, data))
+        {
+            errors_per_class[frames[i].cls]++;
+            errors++;
+            printf("line %u: %s frame decoded as %d\n", frames[i].line, class_names[frames[i].cls], (int)err);
+        }
+    }
+
+    // brzina: cijeli korpus vise puta; checksum rezultata cuva petlju od optimizatora
+    unsigned sink = 0;
+    int64_t start = now_ns();
+    for (unsigned long r = 0; r < repeat; r++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            uint8_t data[DHT_DATA_BYTES];
+            sink += (unsigned)dht_decode_edges(frames[i].edges, frames[i].count, data) + data[0];
+        }
+    }
+    int64_t elapsed = now_ns() - start;
+    uint64_t decoded = (uint64_t)count * repeat;
+
+    printf("frames: %zu (", count);
+    for (int c = 0; c < CLASS_COUNT; c++)
+        printf("%s%s=%u", c ? " " : "", class_names[c], frames_per_class[c]);
+    printf("), edges: %zu\n", edges);
+    printf("errors: %u (", errors);
+    for (int c = 0; c < CLASS_COUNT; c++)
+        printf("%s%s=%u", c ? " " : "", class_names[c], errors_per_class[c]);
+    printf("), error rate %.2f %%\n", count ? 100.0 * errors / count : 0.0);
+    if (decoded && elapsed > 0)
+    {
+        printf("throughput: %.0f frames/s, %.1f ns/frame, %.2f ns/edge (%" PRIu64 " decodes, sink %u)\n",
+               decoded * 1e9 / elapsed, (double)elapsed / decoded, (double)elapsed / ((double)edges * repeat), decoded,
+               sink & 0xFF);
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Cijena pretvorbe okvira u ispis: float racun i %.1f prema desetinkama
+ * iz dht_frame_to_tenths i cjelobrojnom printf-u.
+ *
+ * Za sve vrijednosti koje AM2301 i DHT11 mogu poslati provjerava da oba
+ * puta ispisu isti tekst (izlazni kod 1 ako ne), a zatim mjeri ciklusa
+ * po uzorku za float put, cjelobrojni put i samo dht_frame_to_tenths.
+ *
+ *   dht_format_bench [ponavljanja]
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "dht_decode.h"
+
+#define DEFAULT_ITERATIONS 100000
+#define FRAMES 1024
+#define LINE_LEN 64
+
+typedef struct
+{
+    dht_type_t type;
+    uint8_t data[DHT_DATA_BYTES];
+} frame_t;
+
+static frame_t frames[FRAMES];
+
+// kako je demo radio prije: float iz bajtova pa %.1f
+__attribute__((noinline)) static int format_float(char *buf, size_t size, const frame_t *f)
+{
+    const uint8_t *data = f->data;
+    float humidity;
+    float temperature;
+
+    if (f->type == DHT_TYPE_DHT11)
+    {
+        humidity = data[0] + (data[1] % 10) * 0.1f;
+        temperature = data[2] + ((data[3] & 0x7F) % 10) * 0.1f;
+        if (data[3] & 0x80)
+            temperature = -temperature;
+    }
+    else
+    {
+        humidity = ((data[0] << 8) | data[1]) * 0.1f;
+        temperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+        if (data[2] & 0x80)
+            temperature = -temperature;
+    }
+    return snprintf(buf, size, "Humidity: %.1f %% Temperature: %.1f C", humidity, temperature);
+}
+
+// kako demo radi sada: desetinke ostaju cijeli brojevi sve do ispisa
+__attribute__((noinline)) static int format_fixed(char *buf, size_t size, const frame_t *f)
+{
+    int16_t temperature;
+    uint16_t humidity;
+    dht_frame_to_tenths(f->type, f->data, &temperature, &humidity);
+
+    unsigned t_abs = temperature < 0 ? (unsigned)-temperature : (unsigned)temperature;
+    return snprintf(buf, size, "Humidity: %u.%u %% Temperature: %s%u.%u C", humidity / 10, humidity % 10,
+                    temperature < 0 ? "-" : "", t_abs / 10, t_abs % 10);
+}
+
+static void make_frame(frame_t *f, dht_type_t type, int temperature, unsigned humidity)
+{
+    unsigned t_abs = temperature < 0 ? (unsigned)-temperature : (unsigned)temperature;
+
+    f->type = type;
+    if (type == DHT_TYPE_DHT11)
+    {
+        f->data[0] = (uint8_t)(humidity / 10);
+        f->data[1] = (uint8_t)(humidity % 10);
+        f->data[2] = (uint8_t)(t_abs / 10);
+        f->data[3] = (uint8_t)(t_abs % 10 | (temperature < 0 ? 0x80 : 0));
+    }
+    else
+    {
+        f->data[0] = (uint8_t)(humidity >> 8);
+        f->data[1] = (uint8_t)humidity;
+        f->data[2] = (uint8_t)(t_abs >> 8 | (temperature < 0 ? 0x80 : 0));
+        f->data[3] = (uint8_t)t_abs;
+    }
+    f->data[4] = (uint8_t)(f->data[0] + f->data[1] + f->data[2] + f->data[3]);
+}
+
+// oba puta moraju dati isti tekst za svaku vrijednost iz podrucja senzora
+static unsigned check_equal(void)
+{
+    char a[LINE_LEN];
+    char b[LINE_LEN];
+    unsigned mismatches = 0;
+    frame_t f;
+
+    for (int type = DHT_TYPE_DHT11; type <= DHT_TYPE_AM2301; type++)
+    {
+        int t_min = type == DHT_TYPE_DHT11 ? -200 : -400;
+        int t_max = type == DHT_TYPE_DHT11 ? 600 : 800;
+        for (int t = t_min; t <= t_max; t++)
+        {
+            for (unsigned h = 0; h <= 1000; h += 7)
+            {
+                make_frame(&f, (dht_type_t)type, t, h);
+                format_float(a, sizeof(a), &f);
+                format_fixed(b, sizeof(b), &f);
+                if (strcmp(a, b) != 0)
+                {
+                    if (mismatches++ < 5)
+                        printf("razlika: \"%s\" / \"%s\"\n", a, b);
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    uint32_t rng = 0x9E3779B9;
+    char buf[LINE_LEN];
+    unsigned sink = 0;
+
+    for (size_t i = 0; i < FRAMES; i++)
+    {
+        dht_type_t type = i % 2 ? DHT_TYPE_AM2301 : DHT_TYPE_DHT11;
+        int t = (int)(next_random(&rng) % 600) - 100;
+        make_frame(&frames[i], type, t, next_random(&rng) % 1001);
+    }
+
+    unsigned mismatches = check_equal();
+    printf("float i cjelobrojni ispis: %u razlika\n", mismatches);
+
+    uint64_t start = cycles();
+    for (unsigned long i = 0; i < iterations; i++)
+        sink += (unsigned)format_float(buf, sizeof(buf), &frames[i % FRAMES]) + (uint8_t)buf[10];
+    uint64_t float_cycles = cycles() - start;
+
+    start = cycles();
+    for (unsigned long i = 0; i < iterations; i++)
+        sink += (unsigned)format_fixed(buf, sizeof(buf), &frames[i % FRAMES]) + (uint8_t)buf[10];
+    uint64_t fixed_cycles = cycles() - start;
+
+    start = cycles();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        int16_t t;
+        uint16_t h;
+        dht_frame_to_tenths(frames[i % FRAMES].type, frames[i % FRAMES].data, &t, &h);
+        sink += (unsigned)t + h;
+    }
+    uint64_t tenths_cycles = cycles() - start;
+
+    if (iterations)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        const char *unit = "ciklusa";
+#else
+        const char *unit = "ns";
+#endif
+        printf("float + %%.1f:              %.1f %s/uzorak\n", (double)float_cycles / iterations, unit);
+        printf("desetinke + cjelobrojni:   %.1f %s/uzorak\n", (double)fixed_cycles / iterations, unit);
+        printf("samo dht_frame_to_tenths:  %.1f %s/uzorak (sink %u)\n", (double)tenths_cycles / iterations, unit,
+               sink & 0xFF);
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Cijeli driver (dht_async, dht_capture, dht_decode, dht_bus) nad
+ * simuliranim senzorom (dht_hal_sim.c) i virtualnim esp_timerom.
+ *
+ * Svaki scenarij napravi zadani broj citanja i usporedi rezultat s onim
+ * sto je simulator poslao: citanje bez ubacene greske mora vratiti tocne
+ * vrijednosti, a niti jedno citanje ne smije vratiti ESP_OK s krivim
+ * vrijednostima. Simulator salje bridove u njihovo vrijeme, pa latencija
+ * po virtualnom satu ukljucuje i okvir: citanje bez izgubljenog brida mora
+ * zavrsiti na zadnjem bridu, prije kraja prozora hvatanja, a nijedno ne
+ * smije trajati dulje od start impulsa i prozora. Uz to se ispisuje koliko
+ * procesorskog vremena hosta trosi jedno citanje.
+ *
+ *   dht_sim_harness [citanja]
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dht_async.h"
+#include "dht_bus.h"
+#include "dht_sim.h"
+
+#define DEFAULT_READS 10000
+#define SENSOR_PIN 14
+#define BUS_SENSORS 4
+#define BUS_FIRST_PIN 100
+#define BUS_POLL_US (1000 * 1000)
+
+typedef struct
+{
+    const char *name;
+    dht_sim_config_t config;
+} scenario_t;
+
+typedef struct
+{
+    uint32_t reads;
+    uint32_t ok;
+    uint32_t timeouts;
+    uint32_t bad_pulses;
+    uint32_t checksum_errors;
+    uint32_t wrong; // ESP_OK, ali ne ono sto je senzor poslao
+    uint32_t missed; // citanje bez ubacene greske koje nije vratilo tocne vrijednosti
+    uint32_t overdue; // citanje dulje od dopustenog, vidi opis gore
+    int64_t min_latency_us;
+    int64_t max_latency_us;
+    int64_t total_latency_us;
+} result_t;
+
+static const scenario_t scenarios[] = {
+    {"am2301 clean", {.type = DHT_TYPE_AM2301, .jitter_us = 8, .seed = 1}},
+    {"dht11 clean", {.type = DHT_TYPE_DHT11, .jitter_us = 8, .seed = 2}},
+    {"am2301 faults",
+     {.type = DHT_TYPE_AM2301,
+      .jitter_us = 8,
+      .drop_edge_permille = 10,
+      .bad_checksum_permille = 10,
+      .no_response_permille = 10,
+      .seed = 3}},
+};
+
+static dht_reading_t last_reading;
+static bool have_reading;
+
+static void store_reading(const dht_reading_t *reading, void *arg)
+{
+    (void)arg;
+    last_reading = *reading;
+    have_reading = true;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// vrijednosti koje tip senzora moze prenijeti bez gubitka
+static void pick_values(dht_type_t type, uint32_t *rng, int16_t *temperature, uint16_t *humidity)
+{
+    if (type == DHT_TYPE_DHT11)
+    {
+        *temperature = (int16_t)(next_random(rng) % 500);
+        *humidity = (uint16_t)(200 + next_random(rng) % 700);
+        return;
+    }
+    *temperature = (int16_t)((int32_t)(next_random(rng) % 1200) - 400);
+    *humidity = (uint16_t)(next_random(rng) % 1001);
+}
+
+static void count_reading(result_t *res, const dht_reading_t *reading)
+{
+    int64_t latency = reading->finished_us - reading->started_us;
+
+    res->reads++;
+    switch (reading->err)
+    {
+    case ESP_OK:
+        res->ok++;
+        break;
+    case ESP_ERR_INVALID_CRC:
+        res->checksum_errors++;
+        break;
+    case ESP_ERR_INVALID_RESPONSE:
+        res->bad_pulses++;
+        break;
+    default:
+        res->timeouts++;
+        break;
+    }
+    if (res->reads == 1 || latency < res->min_latency_us)
+        res->min_latency_us = latency;
+    if (latency > res->max_latency_us)
+        res->max_latency_us = latency;
+    res->total_latency_us += latency;
+}
+
+static bool matches(const dht_reading_t *reading, int16_t temperature, uint16_t humidity)
+{
+    int16_t t;
+    uint16_t h;
+    dht_frame_to_tenths(reading->type, reading->data, &t, &h);
+    return reading->err == ESP_OK && t == temperature && h == humidity;
+}
+
+static void print_result(const char *name, const result_t *res, int64_t cpu_ns)
+{
+    printf("%-14s reads=%" PRIu32 " ok=%" PRIu32 " timeout=%" PRIu32 " pulse=%" PRIu32 " crc=%" PRIu32
+           " wrong=%" PRIu32 " missed=%" PRIu32 " overdue=%" PRIu32 " latency min/avg/max=%" PRId64 "/%" PRId64 "/%" PRId64
+           " us, %.0f ns/read\n",
+           name, res->reads, res->ok, res->timeouts, res->bad_pulses, res->checksum_errors, res->wrong, res->missed, res->overdue,
+           res->min_latency_us, res->reads ? res->total_latency_us / res->reads : 0, res->max_latency_us,
+           res->reads ? (double)cpu_ns / res->reads : 0.0);
+}
+
+static bool run_scenario(const scenario_t *sc, dht_pin_t pin, uint32_t reads)
+{
+    static dht_sensor_t sensor;
+    result_t res = {0};
+    uint32_t rng = sc->config.seed * 2654435761u | 1;
+
+    ESP_ERROR_CHECK(dht_sim_attach(pin, &sc->config));
+    ESP_ERROR_CHECK(dht_sensor_init(&sensor, pin, sc->config.type));
+
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < reads; i++)
+    {
+        int16_t temperature;
+        uint16_t humidity;
+        pick_values(sc->config.type, &rng, &temperature, &humidity);
+        dht_sim_set_values(pin, temperature, humidity);
+
+        dht_sim_stats_t before, after;
+        dht_sim_get_stats(pin, &before);
+
+        have_reading = false;
+        ESP_ERROR_CHECK(dht_read_start(&sensor, store_reading, NULL));
+        while (!have_reading && host_timer_run_next())
+            ;
+        if (!have_reading)
+        {
+            fprintf(stderr, "%s: read %" PRIu32 " never finished\n", sc->name, i);
+            return false;
+        }
+        count_reading(&res, &last_reading);
+
+        // senzor mora odmoriti prije sljedeceg citanja
+        host_timer_run_until(esp_timer_get_time() + AM2301_MIN_INTERVAL_US);
+
+        dht_sim_get_stats(pin, &after);
+        bool dropped = after.dropped_edges != before.dropped_edges;
+        bool corrupted = after.bad_checksums != before.bad_checksums;
+        bool silent = after.no_response != before.no_response;
+        bool right = matches(&last_reading, temperature, humidity);
+
+        if (last_reading.err == ESP_OK && !right)
+            res.wrong++;
+        if (silent ? last_reading.err != ESP_ERR_TIMEOUT
+                   : !dropped && (corrupted ? last_reading.err != ESP_ERR_INVALID_CRC : !right))
+            res.missed++;
+
+        int64_t latency = last_reading.finished_us - last_reading.started_us;
+        int64_t window_end = sensor.start_pulse_us + DHT_CAPTURE_WINDOW_US;
+        if (latency > window_end || (!dropped && !silent && latency >= window_end))
+            res.overdue++;
+    }
+    print_result(sc->name, &res, now_ns() - start);
+    return res.wrong == 0 && res.missed == 0 && res.overdue == 0;
+}
+
+static void count_bus_reading(const dht_reading_t *reading, void *arg)
+{
+    result_t *res = (result_t *)arg;
+
+    count_reading(res, reading);
+    if (!matches(reading, (int16_t)(215 + (reading->pin - BUS_FIRST_PIN)), 453))
+        res->missed++;
+}
+
+// krug svake sekunde, a AM2301 smije svake dvije: svaki drugi krug se sav preskace
+static bool run_bus(uint32_t reads)
+{
+    static dht_bus_t bus;
+    result_t res = {0};
+
+    ESP_ERROR_CHECK(dht_bus_init(&bus, count_bus_reading, &res));
+    for (int i = 0; i < BUS_SENSORS; i++)
+    {
+        const dht_sim_config_t config = {
+            .type = DHT_TYPE_AM2301,
+            .temperature = (int16_t)(215 + i),
+            .humidity = 453,
+            .jitter_us = 8,
+            .seed = 10 + (uint32_t)i,
+        };
+        ESP_ERROR_CHECK(dht_sim_attach(BUS_FIRST_PIN + i, &config));
+        if (dht_bus_add(&bus, BUS_FIRST_PIN + i, DHT_TYPE_AM2301) < 0)
+        {
+            fprintf(stderr, "bus: could not add sensor %d\n", i);
+            return false;
+        }
+    }
+
+    int64_t start = now_ns();
+    uint32_t rounds = 0;
+    uint32_t unclosed = 0;
+    while (res.reads < reads)
+    {
+        int64_t round_start = esp_timer_get_time();
+        bus.last_round_us = -1;
+        if (dht_bus_poll(&bus) != ESP_OK)
+        {
+            fprintf(stderr, "bus: round %" PRIu32 " still busy\n", rounds);
+            return false;
+        }
+        while (dht_bus_busy(&bus) && host_timer_run_next())
+            ;
+        if (bus.last_round_us < 0)
+            unclosed++;
+        rounds++;
+        host_timer_run_until(round_start + BUS_POLL_US);
+    }
+    int64_t cpu_ns = now_ns() - start;
+
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < bus.count; i++)
+    {
+        dht_bus_stats_t stats;
+        dht_bus_get_stats(&bus, i, &stats);
+        skipped += stats.skipped;
+    }
+    print_result("bus x4", &res, cpu_ns);
+    printf("%-14s rounds=%" PRIu32 " unclosed=%" PRIu32 " skipped=%" PRIu32 " last round %" PRId64 " us\n", "", rounds,
+           unclosed, skipped, bus.last_round_us);
+    return res.missed == 0 && unclosed == 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t reads = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : DEFAULT_READS;
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        ok &= run_scenario(&scenarios[i], SENSOR_PIN + (dht_pin_t)i, reads);
+    ok &= run_bus(reads);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include "esp_timer.h"
+
+#include <stddef.h>
+
+#define HOST_TIMER_MAX 32
+
+struct esp_timer
+{
+    bool used;
+    bool armed;
+    esp_timer_cb_t callback;
+    void *arg;
+    int64_t expiry_us;
+    uint64_t period_us;
+    uint64_t order; // timeri s istim vremenom idu redom kojim su pokrenuti
+};
+
+static struct esp_timer timers[HOST_TIMER_MAX];
+static int64_t now_us;
+static uint64_t next_order;
+
+static void arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    timer->armed = true;
+    timer->expiry_us = now_us + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    timer->order = next_order++;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    for (size_t i = 0; i < HOST_TIMER_MAX; i++)
+    {
+        if (!timers[i].used)
+        {
+            timers[i] = (struct esp_timer){.used = true, .callback = args->callback, .arg = args->arg};
+            *out_handle = &timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    arm(timer, timeout_us, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    arm(timer, period, period);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->used = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+static esp_timer_handle_t first_due(void)
+{
+    esp_timer_handle_t first = NULL;
+    for (size_t i = 0; i < HOST_TIMER_MAX; i++)
+    {
+        esp_timer_handle_t t = &timers[i];
+        if (!t->used || !t->armed)
+            continue;
+        if (!first || t->expiry_us < first->expiry_us ||
+            (t->expiry_us == first->expiry_us && t->order < first->order))
+            first = t;
+    }
+    return first;
+}
+
+static void fire(esp_timer_handle_t timer)
+{
+    if (timer->expiry_us > now_us)
+        now_us = timer->expiry_us;
+    if (timer->period_us)
+        arm(timer, timer->period_us, timer->period_us);
+    else
+        timer->armed = false;
+    timer->callback(timer->arg);
+}
+
+bool host_timer_run_next(void)
+{
+    esp_timer_handle_t timer = first_due();
+    if (!timer)
+        return false;
+    fire(timer);
+    return true;
+}
+
+void host_timer_run_until(int64_t until_us)
+{
+    esp_timer_handle_t timer;
+    while ((timer = first_due()) && timer->expiry_us <= until_us)
+        fire(timer);
+    if (until_us > now_us)
+        now_us = until_us;
+}
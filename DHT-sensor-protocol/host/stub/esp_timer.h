@@ -0,0 +1,46 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+/*
+ * esp_timer nad virtualnim satom. Nista ne radi samo od sebe: host program
+ * pomice vrijeme s host_timer_run_until / host_timer_run_next, a timeri
+ * cije je vrijeme doslo pozivaju se redom, u istom threadu.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+/* Pokrece sljedeci timer na redu; false ako nijedan nije pokrenut */
+bool host_timer_run_next(void);
+
+/* Pokrece sve timere do until_us i ostavlja sat na until_us */
+void host_timer_run_until(int64_t until_us);
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,7 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+/* Host build se ponasa kao ESP-IDF Linux target: HAL je simulirani senzor */
+#define CONFIG_IDF_TARGET_LINUX 1
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,74 @@
+#ifndef DHT_ASYNC_H
+#define DHT_ASYNC_H
+
+/*
+ * Neblokirajuce citanje DHT senzora.
+ *
+ * Citanje je automat stanja kojeg pokrece esp_timer:
+ *   START   - linija drzi 0 tijekom start impulsa (20 ms za DHT11, 2 ms za AM2301)
+ *   CAPTURE - linija pustena, prekidna rutina biljezi bridove
+ *   DECODE  - okvir se dekodira i rezultat predaje callbacku
+ * Niti jedan zadatak ne ceka aktivno; pozivatelj dobiva rezultat kroz
+ * callback ili red (dht_queue_cb).
+ */
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "dht_capture.h"
+#include "dht_decode.h"
+#include "dht_hal.h"
+
+#define DHT11_START_PULSE_US 20000 // DHT11 trazi barem 18 ms
+#define AM2301_START_PULSE_US 2000 // AM2301 trazi barem 1 ms
+#define DHT_CAPTURE_WINDOW_US 6000
+
+typedef enum
+{
+    DHT_STATE_IDLE = 0,
+    DHT_STATE_START,
+    DHT_STATE_CAPTURE,
+} dht_state_t;
+
+typedef struct
+{
+    dht_pin_t pin;
+    dht_type_t type;
+    esp_err_t err; // ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_RESPONSE ili ESP_ERR_INVALID_CRC
+    uint8_t data[DHT_DATA_BYTES];
+    int64_t started_us;
+    int64_t finished_us;
+} dht_reading_t;
+
+typedef void (*dht_read_cb_t)(const dht_reading_t *reading, void *arg);
+
+typedef struct
+{
+    dht_pin_t pin;
+    dht_type_t type;
+    uint32_t start_pulse_us;
+    volatile dht_state_t state;
+    dht_capture_t capture;
+    esp_timer_handle_t timer;
+    dht_read_cb_t cb;
+    void *cb_arg;
+    int64_t started_us;
+} dht_sensor_t;
+
+esp_err_t dht_sensor_init(dht_sensor_t *sensor, dht_pin_t pin, dht_type_t type);
+
+/*
+ * Pokrece citanje i odmah se vraca. Callback se poziva iz esp_timer
+ * zadatka kad je citanje gotovo. Vraca ESP_ERR_INVALID_STATE ako je
+ * prethodno citanje jos u tijeku.
+ */
+esp_err_t dht_read_start(dht_sensor_t *sensor, dht_read_cb_t cb, void *arg);
+
+/* Gotov callback koji salje dht_reading_t u red predan kao arg */
+void dht_queue_cb(const dht_reading_t *reading, void *arg);
+
+#endif // DHT_ASYNC_H
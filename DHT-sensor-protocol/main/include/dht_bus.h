@@ -0,0 +1,83 @@
+#ifndef DHT_BUS_H
+#define DHT_BUS_H
+
+/*
+ * Upravljanje s vise DHT senzora na razlicitim pinovima.
+ *
+ * Jedan krug citanja (dht_bus_poll) pokrece start impulse senzora jedan
+ * za drugim s razmakom DHT_BUS_STAGGER_US, tako da se njihova cekanja
+ * preklapaju, a prekidi od prijenosa podataka ne padaju u isto vrijeme.
+ * Senzor koji je citan prije isteka svog minimalnog intervala se
+ * preskace u tom krugu. Sav raspored se izvrsava u esp_timer zadatku.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "dht_async.h"
+
+#define DHT_BUS_MAX_SENSORS 8
+#define DHT_BUS_STAGGER_US 3000
+
+#define DHT11_MIN_INTERVAL_US (1000 * 1000)
+#define AM2301_MIN_INTERVAL_US (2000 * 1000)
+
+typedef struct
+{
+    uint32_t reads;
+    uint32_t ok;
+    uint32_t timeouts;
+    uint32_t bad_pulses;
+    uint32_t checksum_errors;
+    uint32_t skipped; // krug u kojem senzor jos nije smio biti citan
+    uint32_t last_latency_us;
+    uint32_t min_latency_us;
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} dht_bus_stats_t;
+
+typedef struct dht_bus dht_bus_t;
+
+typedef struct
+{
+    dht_sensor_t sensor;
+    dht_bus_t *bus;
+    int64_t min_interval_us;
+    int64_t last_start_us;
+    dht_bus_stats_t stats;
+} dht_bus_slot_t;
+
+struct dht_bus
+{
+    dht_bus_slot_t slots[DHT_BUS_MAX_SENSORS];
+    size_t count;
+    size_t next;        // sljedeci senzor u trenutnom krugu
+    size_t outstanding; // pokrenuta, a nezavrsena citanja
+    esp_timer_handle_t stagger_timer;
+    int64_t round_started_us;
+    int64_t last_round_us;
+    dht_read_cb_t cb;
+    void *cb_arg;
+    portMUX_TYPE lock;
+};
+
+/* cb se poziva za svako zavrseno citanje (iz esp_timer zadatka) */
+esp_err_t dht_bus_init(dht_bus_t *bus, dht_read_cb_t cb, void *arg);
+
+/* Vraca indeks senzora ili -1 ako je sabirnica puna / init nije uspio */
+int dht_bus_add(dht_bus_t *bus, dht_pin_t pin, dht_type_t type);
+
+/* Pokrece novi krug; ESP_ERR_INVALID_STATE ako prethodni jos traje */
+esp_err_t dht_bus_poll(dht_bus_t *bus);
+
+bool dht_bus_busy(dht_bus_t *bus);
+
+/* Kopija statistike jednog senzora */
+esp_err_t dht_bus_get_stats(dht_bus_t *bus, size_t index, dht_bus_stats_t *stats);
+
+#endif // DHT_BUS_H
@@ -0,0 +1,43 @@
+#ifndef DHT_CAPTURE_H
+#define DHT_CAPTURE_H
+
+/*
+ * Hvatanje bridova DHT signala preko GPIO prekida.
+ *
+ * Prekidna rutina samo zapisuje vrijeme i razinu svakog brida u spremnik,
+ * a dekodiranje (dht_decode.h) se radi naknadno. Kad stigne zadnji
+ * ocekivani brid, prekidna rutina javlja kraj okvira preko done callbacka,
+ * pa citanje ne mora cekati cijeli prozor hvatanja.
+ */
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "dht_decode.h"
+#include "dht_hal.h"
+
+/* odgovor (F, R, F) + 40 bitova (R, F) */
+#define DHT_CAPTURE_EDGES_EXPECTED (3 + 2 * DHT_DATA_BITS)
+#define DHT_CAPTURE_MAX_EDGES 96
+
+/* Poziva se iz prekidne rutine kad je okvir cijeli; mora biti u IRAM-u */
+typedef void (*dht_capture_done_cb_t)(void *arg);
+
+typedef struct
+{
+    dht_pin_t pin;
+    dht_edge_t edges[DHT_CAPTURE_MAX_EDGES];
+    volatile size_t count;
+    dht_capture_done_cb_t done;
+    void *done_arg;
+} dht_capture_t;
+
+esp_err_t dht_capture_init(dht_capture_t *cap, dht_pin_t pin, dht_capture_done_cb_t done, void *arg);
+
+/* Pocinje biljeziti bridove; pin mora vec biti postavljen kao ulaz */
+esp_err_t dht_capture_start(dht_capture_t *cap);
+
+void dht_capture_stop(dht_capture_t *cap);
+
+#endif // DHT_CAPTURE_H
@@ -0,0 +1,83 @@
+#ifndef DHT_DECODE_H
+#define DHT_DECODE_H
+
+/*
+ * Dekodiranje DHT okvira iz snimljenih bridova signala.
+ *
+ * Ovaj dio ne ovisi o ESP-IDF-u (samo standardni C) kako bi se mogao
+ * prevesti i na Linux racunalu te provjeriti na snimljenim tragovima.
+ *
+ * Svaki bit pocinje niskim impulsom od ~50 us, a zatim slijedi visoki
+ * impuls od ~26-28 us (0) ili ~70 us (1). Prag za odluku se ne uzima
+ * kao fiksnih 50 us nego se mjeri iz niskog impulsa istog bita, pa
+ * odstupanje takta senzora i kapacitet kabela pomicu prag zajedno sa
+ * samim bitom.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DHT_DATA_BITS 40
+#define DHT_DATA_BYTES 5
+
+typedef enum
+{
+    DHT_TYPE_DHT11 = 0,
+    DHT_TYPE_AM2301, // AM2301 / DHT21 / DHT22
+} dht_type_t;
+
+/* granice u kojima impulsi jos izgledaju kao DHT signal */
+#define DHT_LOW_MIN_US 20
+#define DHT_LOW_MAX_US 120
+#define DHT_HIGH_MAX_US 120
+
+/* Jedan brid na podatkovnoj liniji: vrijeme (us) i razina nakon brida */
+typedef struct
+{
+    uint32_t time_us;
+    uint8_t level;
+} dht_edge_t;
+
+/* Jedan bit na liniji: niski uvodni impuls i visoki impuls koji nosi vrijednost */
+typedef struct
+{
+    uint16_t low_us;
+    uint16_t high_us;
+} dht_pulse_t;
+
+typedef enum
+{
+    DHT_DECODE_OK = 0,
+    DHT_DECODE_ERR_SHORT,    // premalo impulsa za cijeli okvir
+    DHT_DECODE_ERR_PULSE,    // impuls izvan dopustenih granica
+    DHT_DECODE_ERR_CHECKSUM, // okvir procitan, ali checksum ne odgovara
+} dht_decode_err_t;
+
+/*
+ * Pretvara niz bridova u parove (nisko, visoko). Vraca broj zapisanih
+ * parova; odgovor senzora (80/80 us) je prvi par ako je uhvacen.
+ */
+size_t dht_edges_to_pulses(const dht_edge_t *edges, size_t count, dht_pulse_t *pulses, size_t max_pulses);
+
+/*
+ * Dekodira zadnjih 40 parova u 5 bajtova i provjerava checksum.
+ * Cista funkcija: ne cita GPIO ni vrijeme. Bajtovi se upisuju i kad
+ * checksum ne odgovara, kako bi se greska mogla analizirati.
+ */
+dht_decode_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t data[DHT_DATA_BYTES]);
+
+/*
+ * dht_edges_to_pulses + dht_decode_pulses. Trazi i par odgovora ispred
+ * 40 bitova; bez njega vraca DHT_DECODE_ERR_SHORT.
+ */
+dht_decode_err_t dht_decode_edges(const dht_edge_t *edges, size_t count, uint8_t data[DHT_DATA_BYTES]);
+
+/*
+ * Pretvara bajtove okvira u desetinke (0.1 C, 0.1 %RH), bez float racuna.
+ *   DHT11:  cijeli dio i desetinke u zasebnim bajtovima, bit 7 desetinki
+ *           temperature je predznak kod novijih senzora
+ *   AM2301: 16-bitne desetinke, bit 15 temperature je predznak
+ */
+void dht_frame_to_tenths(dht_type_t type, const uint8_t data[DHT_DATA_BYTES], int16_t *temperature, uint16_t *humidity);
+
+#endif // DHT_DECODE_H
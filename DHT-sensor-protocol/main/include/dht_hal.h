@@ -0,0 +1,43 @@
+#ifndef DHT_HAL_H
+#define DHT_HAL_H
+
+/*
+ * Tanki sloj ispod DHT drivera: pin, razina, prekid na bridovima i vrijeme.
+ *
+ * Na pravom cipu (dht_hal_gpio.c) funkcije samo prosljeduju pozive na
+ * driver/gpio i esp_timer. Za ESP-IDF Linux target (dht_hal_sim.c) iza
+ * istog sucelja stoji simulirani senzor (dht_sim.h), pa se driver moze
+ * vrtjeti bez ploce. Izvor se bira prema IDF_TARGET u CMakeLists.txt.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+typedef int dht_pin_t;
+#else
+#include "driver/gpio.h"
+typedef gpio_num_t dht_pin_t;
+#endif
+
+/* Poziva se na svaki brid dok je prekid ukljucen (na cipu iz ISR-a) */
+typedef void (*dht_hal_edge_cb_t)(void *arg);
+
+/* Ulaz s pull-upom, linija u mirovanju visoko */
+esp_err_t dht_hal_pin_init(dht_pin_t pin);
+
+/* true: pin tjera liniju, false: pin pusta liniju i samo slusa */
+void dht_hal_set_output(dht_pin_t pin, bool output);
+void dht_hal_set_level(dht_pin_t pin, int level);
+int dht_hal_get_level(dht_pin_t pin);
+
+/* Vrijeme u us; unutar edge callbacka je to vrijeme brida */
+int64_t dht_hal_time_us(void);
+
+esp_err_t dht_hal_edge_cb_add(dht_pin_t pin, dht_hal_edge_cb_t cb, void *arg);
+esp_err_t dht_hal_edge_enable(dht_pin_t pin, bool enable);
+
+#endif // DHT_HAL_H
@@ -0,0 +1,57 @@
+#ifndef DHT_SIM_H
+#define DHT_SIM_H
+
+/*
+ * Simulirani DHT senzor za ESP-IDF Linux target.
+ *
+ * Kad driver pusti liniju nakon dovoljno dugog start impulsa, simulator
+ * generira cijeli okvir (odgovor 80/80 us, 40 bitova, otpustanje) i
+ * svaki brid zakaze na esp_timeru u njegovo vrijeme. Okvir zato traje
+ * kao na senzoru, 4-5 ms, a driverov prozor hvatanja i timeout teku
+ * izmedu bridova kao na cipu. Svaki impuls se moze pomaknuti za slucajni
+ * jitter, a po okviru se s danim vjerojatnostima gubi brid, kvari checksum
+ * ili senzor ne odgovara. Slucajni brojevi ovise samo o seedu, pa se isti
+ * niz okvira moze ponoviti.
+ *
+ * Konfiguracija se postavlja prije citanja; sve ostalo se vrti u
+ * esp_timer zadatku zajedno s driverom.
+ */
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "dht_decode.h"
+#include "dht_hal.h"
+
+#define DHT_SIM_MAX_PINS 8
+
+typedef struct
+{
+    dht_type_t type;
+    int16_t temperature;            // 0.1 C
+    uint16_t humidity;              // 0.1 %RH
+    uint16_t jitter_us;             // najveci pomak svakog impulsa, +/-
+    uint16_t drop_edge_permille;    // okvir u kojem se izgubi jedan brid
+    uint16_t bad_checksum_permille; // okvir s pokvarenim checksumom
+    uint16_t no_response_permille;  // start impuls bez odgovora
+    uint32_t seed;
+} dht_sim_config_t;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t short_starts; // start impuls prekratak za ovaj tip senzora
+    uint32_t no_response;
+    uint32_t dropped_edges;
+    uint32_t bad_checksums;
+} dht_sim_stats_t;
+
+esp_err_t dht_sim_attach(dht_pin_t pin, const dht_sim_config_t *config);
+
+/* Nove vrijednosti za sljedece okvire */
+esp_err_t dht_sim_set_values(dht_pin_t pin, int16_t temperature, uint16_t humidity);
+
+esp_err_t dht_sim_get_stats(dht_pin_t pin, dht_sim_stats_t *stats);
+
+#endif // DHT_SIM_H
@@ -1,99 +1,135 @@
-#include "driver/gpio.h"
+#include "dht_bus.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
-#include "rom/ets_sys.h"
+#include "inttypes.h"
 #include "stdio.h"
+#include "sdkconfig.h"
 
-#define SENSOR_PIN GPIO_NUM_14
+#if CONFIG_IDF_TARGET_LINUX
+#include "dht_sim.h"
+#endif
 
-static portMUX_TYPE gpio_mux = portMUX_INITIALIZER_UNLOCKED;
+#define READ_PERIOD_US (3000 * 1000)
+#define STATS_EVERY_ROUNDS 20
 
-int wait_for_level(gpio_num_t pin, int level, int timeout_us)
+typedef struct
 {
-    int64_t start = esp_timer_get_time();
-    while (gpio_get_level(pin) != level)
-    {
-        if ((int)(esp_timer_get_time() - start) > timeout_us)
-            return -1;
-    }
-    return 0;
-}
+    dht_pin_t pin;
+    dht_type_t type;
+} sensor_config_t;
+
+static const sensor_config_t sensors[] = {
+    {14, DHT_TYPE_AM2301},
+};
 
-int measure_high_pulse(gpio_num_t pin, int timeout_us)
+static dht_bus_t bus;
+static QueueHandle_t readings;
+
+static void read_timer_cb(void *arg)
 {
-    if (wait_for_level(pin, 1, timeout_us) < 0)
-        return -1;
-    int64_t t0 = esp_timer_get_time();
-    if (wait_for_level(pin, 0, timeout_us) < 0)
-        return -1;
-    return (int)(esp_timer_get_time() - t0);
+    if (dht_bus_poll(&bus) != ESP_OK)
+        printf("Previous round still in progress\n");
 }
 
-void measure_temp_and_humidity()
+void print_temp_and_humidity(const dht_reading_t *reading)
 {
-    gpio_reset_pin(SENSOR_PIN);
-    gpio_set_direction(SENSOR_PIN, GPIO_MODE_OUTPUT);
-
-    // pocni komunikaciju
-    gpio_set_level(SENSOR_PIN, 0);
-    ets_delay_us(20000);
-
-    // cekaj na odgovor senzora
-    gpio_set_level(SENSOR_PIN, 1);
-    ets_delay_us(30);
-    gpio_set_direction(SENSOR_PIN, GPIO_MODE_INPUT);
-
-    if (wait_for_level(SENSOR_PIN, 0, 1000) < 0)
+    printf("[GPIO %d] ", reading->pin);
+    if (reading->err == ESP_ERR_TIMEOUT)
     {
-        printf("No response (wait LOW)\n");
+        printf("No response\n");
         return;
     }
-    if (wait_for_level(SENSOR_PIN, 1, 1000) < 0)
+    if (reading->err == ESP_ERR_INVALID_RESPONSE)
     {
-        printf("No response (wait HIGH)\n");
+        printf("Bad pulse width\n");
         return;
     }
-    if (wait_for_level(SENSOR_PIN, 0, 1000) < 0)
+    if (reading->err == ESP_ERR_INVALID_CRC)
     {
-        printf("No response (start data)\n");
+        printf("Checksum error\n");
         return;
     }
 
-    taskENTER_CRITICAL(&gpio_mux);
-    // citanje podataka
-    int data[5] = {0};
-    for (size_t i = 0; i < 40; i++)
+    // desetinke ostaju cijeli brojevi sve do ispisa
+    int16_t temperature;
+    uint16_t humidity;
+    dht_frame_to_tenths(reading->type, reading->data, &temperature, &humidity);
+
+    unsigned t_abs = temperature < 0 ? (unsigned)-temperature : (unsigned)temperature;
+    printf("Humidity: %u.%u %% Temperature: %s%u.%u C (%" PRId64 " us)\n", humidity / 10, humidity % 10,
+           temperature < 0 ? "-" : "", t_abs / 10, t_abs % 10, reading->finished_us - reading->started_us);
+}
+
+void print_bus_stats(void)
+{
+    printf("Last round: %" PRId64 " us\n", bus.last_round_us);
+    for (size_t i = 0; i < bus.count; i++)
     {
-        int us = measure_high_pulse(SENSOR_PIN, 200);
-        if (us < 0)
-        {
-            printf("Bit timeout\n");
-            taskEXIT_CRITICAL(&gpio_mux);
-            return;
-        }
-        int bit = (us > 50) ? 1 : 0;
-        data[i / 8] = (data[i / 8] << 1) | bit;
+        dht_bus_stats_t stats;
+        dht_bus_get_stats(&bus, i, &stats);
+        uint32_t avg = stats.reads ? (uint32_t)(stats.total_latency_us / stats.reads) : 0;
+        printf("[GPIO %d] reads=%" PRIu32 " ok=%" PRIu32 " timeout=%" PRIu32 " pulse=%" PRIu32 " crc=%" PRIu32
+               " skipped=%" PRIu32 " latency min/avg/max=%" PRIu32 "/%" PRIu32 "/%" PRIu32 " us\n",
+               bus.slots[i].sensor.pin, stats.reads, stats.ok, stats.timeouts, stats.bad_pulses,
+               stats.checksum_errors, stats.skipped, stats.min_latency_us, avg, stats.max_latency_us);
     }
-    taskEXIT_CRITICAL(&gpio_mux);
+}
 
-    // provjera checksum
-    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+#if CONFIG_IDF_TARGET_LINUX
+// bez ploce: na svaki pin iz tablice spaja se simulirani senzor
+static void attach_simulated_sensors(void)
+{
+    for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++)
     {
-        printf("Checksum error\n");
-        return;
+        const dht_sim_config_t config = {
+            .type = sensors[i].type,
+            .temperature = 215,
+            .humidity = 453,
+            .jitter_us = 8,
+            .drop_edge_permille = 10,
+            .bad_checksum_permille = 10,
+            .no_response_permille = 10,
+            .seed = 1 + i,
+        };
+        dht_sim_attach(sensors[i].pin, &config);
     }
-
-    float humidity = data[0] + data[1] * 0.1f;
-    float temperature = data[2] + data[3] * 0.1f;
-    printf("Humidity: %.1f %% Temperature: %.1f C\n", humidity, temperature);
 }
+#endif
 
 void app_main()
 {
+#if CONFIG_IDF_TARGET_LINUX
+    attach_simulated_sensors();
+#endif
+
+    readings = xQueueCreate(2 * DHT_BUS_MAX_SENSORS, sizeof(dht_reading_t));
+    ESP_ERROR_CHECK(dht_bus_init(&bus, dht_queue_cb, readings));
+    for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++)
+    {
+        if (dht_bus_add(&bus, sensors[i].pin, sensors[i].type) < 0)
+            printf("Could not add sensor on GPIO %d\n", sensors[i].pin);
+    }
+
+    // citanje pokrece timer, ovaj zadatak samo ceka rezultate
+    const esp_timer_create_args_t args = {
+        .callback = read_timer_cb,
+        .name = "dht_period",
+    };
+    esp_timer_handle_t period;
+    ESP_ERROR_CHECK(esp_timer_create(&args, &period));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(period, READ_PERIOD_US));
+
+    dht_reading_t reading;
+    size_t received = 0;
     while (1)
     {
-        measure_temp_and_humidity();
-        vTaskDelay(3000 / portTICK_PERIOD_MS);
+        if (xQueueReceive(readings, &reading, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        print_temp_and_humidity(&reading);
+        if (++received % (STATS_EVERY_ROUNDS * bus.count) == 0)
+            print_bus_stats();
     }
-}
\ No newline at end of file
+}
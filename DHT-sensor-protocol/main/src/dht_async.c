@@ -0,0 +1,128 @@
+#include "dht_async.h"
+
+#include "esp_attr.h"
+
+static void dht_finish(dht_sensor_t *sensor, esp_err_t err, const uint8_t *data)
+{
+    dht_reading_t reading = {
+        .pin = sensor->pin,
+        .type = sensor->type,
+        .err = err,
+        .started_us = sensor->started_us,
+        .finished_us = dht_hal_time_us(),
+    };
+    for (size_t i = 0; i < DHT_DATA_BYTES; i++)
+        reading.data[i] = data ? data[i] : 0;
+
+    sensor->state = DHT_STATE_IDLE;
+    if (sensor->cb)
+        sensor->cb(&reading, sensor->cb_arg);
+}
+
+// okvir je cijeli: prozor hvatanja se skracuje na odmah
+static void IRAM_ATTR dht_capture_done(void *arg)
+{
+    dht_sensor_t *sensor = (dht_sensor_t *)arg;
+
+    esp_timer_stop(sensor->timer);
+    esp_timer_start_once(sensor->timer, 0);
+}
+
+static void dht_timer_cb(void *arg)
+{
+    dht_sensor_t *sensor = (dht_sensor_t *)arg;
+
+    switch (sensor->state)
+    {
+    case DHT_STATE_START:
+        // pusti liniju i biljezi odgovor senzora; prozor je samo granica
+        // ako okvir ne stigne cijeli
+        dht_hal_set_level(sensor->pin, 1);
+        dht_capture_start(&sensor->capture);
+        sensor->state = DHT_STATE_CAPTURE;
+        esp_timer_start_once(sensor->timer, DHT_CAPTURE_WINDOW_US);
+        dht_hal_set_output(sensor->pin, false);
+        break;
+
+    case DHT_STATE_CAPTURE:
+    {
+        dht_capture_stop(&sensor->capture);
+
+        uint8_t data[DHT_DATA_BYTES];
+        switch (dht_decode_edges(sensor->capture.edges, sensor->capture.count, data))
+        {
+        case DHT_DECODE_OK:
+            dht_finish(sensor, ESP_OK, data);
+            break;
+        case DHT_DECODE_ERR_CHECKSUM:
+            dht_finish(sensor, ESP_ERR_INVALID_CRC, data);
+            break;
+        case DHT_DECODE_ERR_PULSE:
+            dht_finish(sensor, ESP_ERR_INVALID_RESPONSE, NULL);
+            break;
+        default:
+            dht_finish(sensor, ESP_ERR_TIMEOUT, NULL);
+            break;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+esp_err_t dht_sensor_init(dht_sensor_t *sensor, dht_pin_t pin, dht_type_t type)
+{
+    sensor->pin = pin;
+    sensor->type = type;
+    sensor->start_pulse_us = (type == DHT_TYPE_DHT11) ? DHT11_START_PULSE_US : AM2301_START_PULSE_US;
+    sensor->state = DHT_STATE_IDLE;
+    sensor->cb = NULL;
+    sensor->cb_arg = NULL;
+
+    esp_err_t err = dht_hal_pin_init(pin);
+    if (err != ESP_OK)
+        return err;
+
+    err = dht_capture_init(&sensor->capture, pin, dht_capture_done, sensor);
+    if (err != ESP_OK)
+        return err;
+
+    const esp_timer_create_args_t args = {
+        .callback = dht_timer_cb,
+        .arg = sensor,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "dht",
+    };
+    return esp_timer_create(&args, &sensor->timer);
+}
+
+esp_err_t dht_read_start(dht_sensor_t *sensor, dht_read_cb_t cb, void *arg)
+{
+    if (sensor->state != DHT_STATE_IDLE)
+        return ESP_ERR_INVALID_STATE;
+
+    sensor->cb = cb;
+    sensor->cb_arg = arg;
+    sensor->started_us = dht_hal_time_us();
+    sensor->state = DHT_STATE_START;
+
+    // pocni komunikaciju
+    dht_hal_set_output(sensor->pin, true);
+    dht_hal_set_level(sensor->pin, 0);
+
+    esp_err_t err = esp_timer_start_once(sensor->timer, sensor->start_pulse_us);
+    if (err != ESP_OK)
+    {
+        dht_hal_set_output(sensor->pin, false);
+        sensor->state = DHT_STATE_IDLE;
+    }
+    return err;
+}
+
+void dht_queue_cb(const dht_reading_t *reading, void *arg)
+{
+    QueueHandle_t queue = (QueueHandle_t)arg;
+    xQueueSend(queue, reading, 0);
+}
@@ -0,0 +1,161 @@
+#include "dht_bus.h"
+
+static void dht_bus_read_done(const dht_reading_t *reading, void *arg)
+{
+    dht_bus_slot_t *slot = (dht_bus_slot_t *)arg;
+    dht_bus_t *bus = slot->bus;
+    uint32_t latency = (uint32_t)(reading->finished_us - reading->started_us);
+
+    portENTER_CRITICAL(&bus->lock);
+    dht_bus_stats_t *stats = &slot->stats;
+    stats->reads++;
+    switch (reading->err)
+    {
+    case ESP_OK:
+        stats->ok++;
+        break;
+    case ESP_ERR_INVALID_CRC:
+        stats->checksum_errors++;
+        break;
+    case ESP_ERR_INVALID_RESPONSE:
+        stats->bad_pulses++;
+        break;
+    default:
+        stats->timeouts++;
+        break;
+    }
+    stats->last_latency_us = latency;
+    if (stats->min_latency_us == 0 || latency < stats->min_latency_us)
+        stats->min_latency_us = latency;
+    if (latency > stats->max_latency_us)
+        stats->max_latency_us = latency;
+    stats->total_latency_us += latency;
+
+    bus->outstanding--;
+    if (bus->outstanding == 0 && bus->next >= bus->count)
+        bus->last_round_us = reading->finished_us - bus->round_started_us;
+    portEXIT_CRITICAL(&bus->lock);
+
+    if (bus->cb)
+        bus->cb(reading, bus->cb_arg);
+}
+
+static void dht_bus_start_next(dht_bus_t *bus)
+{
+    int64_t now = dht_hal_time_us();
+
+    while (bus->next < bus->count)
+    {
+        dht_bus_slot_t *slot = &bus->slots[bus->next];
+
+        portENTER_CRITICAL(&bus->lock);
+        bus->next++;
+        // senzor treba odmoriti izmedu dva citanja
+        bool due = slot->last_start_us == 0 || now - slot->last_start_us >= slot->min_interval_us;
+        if (due)
+            bus->outstanding++;
+        else
+            slot->stats.skipped++;
+        portEXIT_CRITICAL(&bus->lock);
+
+        if (!due)
+            continue;
+
+        slot->last_start_us = now;
+        if (dht_read_start(&slot->sensor, dht_bus_read_done, slot) == ESP_OK)
+            break;
+
+        portENTER_CRITICAL(&bus->lock);
+        bus->outstanding--;
+        portEXIT_CRITICAL(&bus->lock);
+    }
+
+    // krug bez ijednog citanja u tijeku (preskoceni ili neuspjeli senzori na kraju)
+    // nema callbacka koji bi ga zatvorio
+    portENTER_CRITICAL(&bus->lock);
+    if (bus->next >= bus->count && bus->outstanding == 0)
+        bus->last_round_us = now - bus->round_started_us;
+    portEXIT_CRITICAL(&bus->lock);
+
+    // ostali senzori krecu s odmakom, dok ovaj jos drzi start impuls
+    if (bus->next < bus->count)
+        esp_timer_start_once(bus->stagger_timer, DHT_BUS_STAGGER_US);
+}
+
+static void dht_bus_timer_cb(void *arg)
+{
+    dht_bus_start_next((dht_bus_t *)arg);
+}
+
+esp_err_t dht_bus_init(dht_bus_t *bus, dht_read_cb_t cb, void *arg)
+{
+    bus->count = 0;
+    bus->next = 0;
+    bus->outstanding = 0;
+    bus->round_started_us = 0;
+    bus->last_round_us = 0;
+    bus->cb = cb;
+    bus->cb_arg = arg;
+    portMUX_INITIALIZE(&bus->lock);
+
+    const esp_timer_create_args_t args = {
+        .callback = dht_bus_timer_cb,
+        .arg = bus,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "dht_bus",
+    };
+    return esp_timer_create(&args, &bus->stagger_timer);
+}
+
+int dht_bus_add(dht_bus_t *bus, dht_pin_t pin, dht_type_t type)
+{
+    if (bus->count >= DHT_BUS_MAX_SENSORS || dht_bus_busy(bus))
+        return -1;
+
+    dht_bus_slot_t *slot = &bus->slots[bus->count];
+    *slot = (dht_bus_slot_t){
+        .bus = bus,
+        .min_interval_us = (type == DHT_TYPE_DHT11) ? DHT11_MIN_INTERVAL_US : AM2301_MIN_INTERVAL_US,
+    };
+    if (dht_sensor_init(&slot->sensor, pin, type) != ESP_OK)
+        return -1;
+
+    bus->count++;
+    bus->next = bus->count; // nema kruga u tijeku
+    return (int)bus->count - 1;
+}
+
+esp_err_t dht_bus_poll(dht_bus_t *bus)
+{
+    portENTER_CRITICAL(&bus->lock);
+    if (bus->next < bus->count || bus->outstanding > 0)
+    {
+        portEXIT_CRITICAL(&bus->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    bus->next = 0;
+    bus->round_started_us = dht_hal_time_us();
+    portEXIT_CRITICAL(&bus->lock);
+
+    // raspored se uvijek vrti u esp_timer zadatku
+    return esp_timer_start_once(bus->stagger_timer, 0);
+}
+
+bool dht_bus_busy(dht_bus_t *bus)
+{
+    portENTER_CRITICAL(&bus->lock);
+    bool busy = bus->next < bus->count || bus->outstanding > 0;
+    portEXIT_CRITICAL(&bus->lock);
+    return busy;
+}
+
+esp_err_t dht_bus_get_stats(dht_bus_t *bus, size_t index, dht_bus_stats_t *stats)
+{
+    if (index >= bus->count)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&bus->lock);
+    *stats = bus->slots[index].stats;
+    portEXIT_CRITICAL(&bus->lock);
+    return ESP_OK;
+}
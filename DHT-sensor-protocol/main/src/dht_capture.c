@@ -0,0 +1,40 @@
+#include "dht_capture.h"
+
+#include "esp_attr.h"
+
+static void IRAM_ATTR dht_capture_isr(void *arg)
+{
+    dht_capture_t *cap = (dht_capture_t *)arg;
+    size_t n = cap->count;
+
+    if (n >= DHT_CAPTURE_MAX_EDGES)
+        return;
+
+    cap->edges[n].time_us = (uint32_t)dht_hal_time_us();
+    cap->edges[n].level = (uint8_t)dht_hal_get_level(cap->pin);
+    cap->count = n + 1;
+
+    if (n + 1 == DHT_CAPTURE_EDGES_EXPECTED && cap->done)
+        cap->done(cap->done_arg);
+}
+
+esp_err_t dht_capture_init(dht_capture_t *cap, dht_pin_t pin, dht_capture_done_cb_t done, void *arg)
+{
+    cap->pin = pin;
+    cap->count = 0;
+    cap->done = done;
+    cap->done_arg = arg;
+
+    return dht_hal_edge_cb_add(pin, dht_capture_isr, cap);
+}
+
+esp_err_t dht_capture_start(dht_capture_t *cap)
+{
+    cap->count = 0;
+    return dht_hal_edge_enable(cap->pin, true);
+}
+
+void dht_capture_stop(dht_capture_t *cap)
+{
+    dht_hal_edge_enable(cap->pin, false);
+}
@@ -0,0 +1,77 @@
+#include "dht_decode.h"
+
+size_t dht_edges_to_pulses(const dht_edge_t *edges, size_t count, dht_pulse_t *pulses, size_t max_pulses)
+{
+    size_t n = 0;
+
+    // trazi niz padajuci -> rastuci -> padajuci brid
+    for (size_t i = 0; i + 2 < count && n < max_pulses; i++)
+    {
+        if (edges[i].level != 0 || edges[i + 1].level != 1 || edges[i + 2].level != 0)
+            continue;
+
+        uint32_t low = edges[i + 1].time_us - edges[i].time_us;
+        uint32_t high = edges[i + 2].time_us - edges[i + 1].time_us;
+        pulses[n].low_us = low > UINT16_MAX ? UINT16_MAX : (uint16_t)low;
+        pulses[n].high_us = high > UINT16_MAX ? UINT16_MAX : (uint16_t)high;
+        n++;
+        i++; // padajuci brid na kraju je pocetak sljedeceg para
+    }
+    return n;
+}
+
+dht_decode_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t data[DHT_DATA_BYTES])
+{
+    if (count < DHT_DATA_BITS)
+        return DHT_DECODE_ERR_SHORT;
+
+    const dht_pulse_t *bits = &pulses[count - DHT_DATA_BITS];
+    for (size_t i = 0; i < DHT_DATA_BYTES; i++)
+        data[i] = 0;
+
+    for (size_t i = 0; i < DHT_DATA_BITS; i++)
+    {
+        uint16_t low = bits[i].low_us;
+        uint16_t high = bits[i].high_us;
+        if (low < DHT_LOW_MIN_US || low > DHT_LOW_MAX_US || high > DHT_HIGH_MAX_US)
+            return DHT_DECODE_ERR_PULSE;
+
+        // 0 je ~0.55 * low, 1 je ~1.4 * low; prag je sam uvodni impuls
+        int bit = (high > low) ? 1 : 0;
+        data[i / 8] = (uint8_t)((data[i / 8] << 1) | bit);
+    }
+
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+        return DHT_DECODE_ERR_CHECKSUM;
+
+    return DHT_DECODE_OK;
+}
+
+dht_decode_err_t dht_decode_edges(const dht_edge_t *edges, size_t count, uint8_t data[DHT_DATA_BYTES])
+{
+    // odgovor + 40 bitova + rezerva za smetnje na pocetku
+    dht_pulse_t pulses[DHT_DATA_BITS + 8];
+    size_t n = dht_edges_to_pulses(edges, count, pulses, sizeof(pulses) / sizeof(pulses[0]));
+    // bez para odgovora izgubljeni brid moze pretvoriti odgovor u prvi bit
+    if (n < DHT_DATA_BITS + 1)
+        return DHT_DECODE_ERR_SHORT;
+    return dht_decode_pulses(pulses, n, data);
+}
+
+void dht_frame_to_tenths(dht_type_t type, const uint8_t data[DHT_DATA_BYTES], int16_t *temperature, uint16_t *humidity)
+{
+    int16_t t;
+
+    if (type == DHT_TYPE_DHT11)
+    {
+        *humidity = (uint16_t)(data[0] * 10 + data[1] % 10);
+        t = (int16_t)(data[2] * 10 + (data[3] & 0x7F) % 10);
+        *temperature = (data[3] & 0x80) ? (int16_t)-t : t;
+        return;
+    }
+
+    // AM2301: predznak i apsolutna vrijednost, ne dvojni komplement
+    *humidity = (uint16_t)((data[0] << 8) | data[1]);
+    t = (int16_t)(((data[2] & 0x7F) << 8) | data[3]);
+    *temperature = (data[2] & 0x80) ? (int16_t)-t : t;
+}
@@ -0,0 +1,55 @@
+#include "dht_hal.h"
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+esp_err_t dht_hal_pin_init(dht_pin_t pin)
+{
+    esp_err_t err = gpio_reset_pin(pin);
+    if (err != ESP_OK)
+        return err;
+    return gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+}
+
+void dht_hal_set_output(dht_pin_t pin, bool output)
+{
+    gpio_set_direction(pin, output ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT);
+}
+
+void dht_hal_set_level(dht_pin_t pin, int level)
+{
+    gpio_set_level(pin, level);
+}
+
+// zove se iz prekidne rutine
+int IRAM_ATTR dht_hal_get_level(dht_pin_t pin)
+{
+    return gpio_get_level(pin);
+}
+
+int64_t IRAM_ATTR dht_hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+esp_err_t dht_hal_edge_cb_add(dht_pin_t pin, dht_hal_edge_cb_t cb, void *arg)
+{
+    // servis moze vec biti instaliran (npr. za drugi senzor)
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+        return err;
+
+    gpio_set_intr_type(pin, GPIO_INTR_DISABLE);
+    return gpio_isr_handler_add(pin, cb, arg);
+}
+
+esp_err_t dht_hal_edge_enable(dht_pin_t pin, bool enable)
+{
+    if (!enable)
+    {
+        gpio_intr_disable(pin);
+        return gpio_set_intr_type(pin, GPIO_INTR_DISABLE);
+    }
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+    return gpio_intr_enable(pin);
+}
@@ -0,0 +1,337 @@
+#include "dht_hal.h"
+#include "dht_sim.h"
+
+#include <stddef.h>
+
+#include "esp_timer.h"
+
+#define SIM_MAX_EDGES (4 + 2 * DHT_DATA_BITS)
+#define SIM_RESPONSE_DELAY_MIN_US 20
+#define SIM_RESPONSE_DELAY_MAX_US 40
+#define SIM_RESPONSE_US 80
+#define SIM_BIT_LOW_US 50
+#define SIM_BIT_ZERO_US 27
+#define SIM_BIT_ONE_US 70
+
+#define DHT11_MIN_START_US 18000
+#define AM2301_MIN_START_US 1000
+
+typedef struct
+{
+    int64_t time_us;
+    int level;
+} sim_edge_t;
+
+typedef struct
+{
+    bool used;
+    bool attached;
+    dht_pin_t pin;
+    dht_sim_config_t config;
+    dht_sim_stats_t stats;
+    uint32_t rng;
+
+    bool output;
+    int level;
+    int64_t low_since_us;
+    bool start_seen; // zadnji start impuls je bio dovoljno dug
+
+    dht_hal_edge_cb_t cb;
+    void *cb_arg;
+    bool edges_enabled;
+
+    // okvir koji senzor upravo salje, brid po brid na esp_timeru
+    esp_timer_handle_t timer;
+    sim_edge_t edges[SIM_MAX_EDGES];
+    size_t edge_count;
+    size_t edge_next;
+    size_t drop; // brid koji callback ne vidi, SIM_MAX_EDGES ako nijedan
+    int line;    // razina koju tjera senzor, 1 kad pusta liniju
+} sim_pin_t;
+
+static sim_pin_t pins[DHT_SIM_MAX_PINS];
+
+static sim_pin_t *sim_find(dht_pin_t pin, bool create)
+{
+    sim_pin_t *free_slot = NULL;
+    for (size_t i = 0; i < DHT_SIM_MAX_PINS; i++)
+    {
+        if (pins[i].used && pins[i].pin == pin)
+            return &pins[i];
+        if (!pins[i].used && !free_slot)
+            free_slot = &pins[i];
+    }
+    if (!create || !free_slot)
+        return NULL;
+
+    *free_slot = (sim_pin_t){.used = true, .pin = pin, .level = 1, .line = 1};
+    return free_slot;
+}
+
+static uint32_t sim_rand(sim_pin_t *p)
+{
+    // xorshift32
+    uint32_t x = p->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p->rng = x;
+    return x;
+}
+
+static bool sim_chance(sim_pin_t *p, uint16_t permille)
+{
+    return permille && sim_rand(p) % 1000 < permille;
+}
+
+static int64_t sim_pulse(sim_pin_t *p, uint32_t us)
+{
+    int32_t jitter = p->config.jitter_us;
+    if (jitter == 0)
+        return us;
+    int32_t d = (int32_t)(sim_rand(p) % (uint32_t)(2 * jitter + 1)) - jitter;
+    return (int32_t)us + d > 1 ? (int32_t)us + d : 1;
+}
+
+static void sim_encode(const dht_sim_config_t *cfg, uint8_t *data)
+{
+    if (cfg->type == DHT_TYPE_DHT11)
+    {
+        // DHT11 daje cijeli dio i desetinke, bez negativnih temperatura
+        int16_t t = cfg->temperature < 0 ? 0 : cfg->temperature;
+        data[0] = cfg->humidity / 10;
+        data[1] = cfg->humidity % 10;
+        data[2] = t / 10;
+        data[3] = t % 10;
+    }
+    else
+    {
+        // AM2301: 16-bitne desetinke, temperatura s bitom predznaka
+        uint16_t t = cfg->temperature < 0 ? (uint16_t)(0x8000 | -cfg->temperature) : (uint16_t)cfg->temperature;
+        data[0] = cfg->humidity >> 8;
+        data[1] = cfg->humidity & 0xFF;
+        data[2] = t >> 8;
+        data[3] = t & 0xFF;
+    }
+    data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+}
+
+static void sim_arm_next(sim_pin_t *p)
+{
+    int64_t wait = p->edges[p->edge_next].time_us - esp_timer_get_time();
+    esp_timer_start_once(p->timer, wait > 0 ? (uint64_t)wait : 0);
+}
+
+// esp_timer: senzor mijenja razinu linije, a prekid na bridu vidi vrijeme timera
+static void sim_edge_cb(void *arg)
+{
+    sim_pin_t *p = (sim_pin_t *)arg;
+    size_t i = p->edge_next++;
+
+    p->line = p->edges[i].level;
+    if (i != p->drop && p->edges_enabled && p->cb)
+        p->cb(p->cb_arg);
+    if (p->edge_next < p->edge_count)
+        sim_arm_next(p);
+}
+
+static void sim_respond(sim_pin_t *p)
+{
+    sim_edge_t *edges = p->edges;
+    size_t n = 0;
+    uint8_t data[DHT_DATA_BYTES];
+
+    if (sim_chance(p, p->config.no_response_permille))
+    {
+        p->stats.no_response++;
+        return;
+    }
+
+    sim_encode(&p->config, data);
+    if (sim_chance(p, p->config.bad_checksum_permille))
+    {
+        data[4] ^= 1u << (sim_rand(p) % 8);
+        p->stats.bad_checksums++;
+    }
+
+    // odgovor senzora
+    int64_t t = dht_hal_time_us() + SIM_RESPONSE_DELAY_MIN_US +
+                sim_rand(p) % (SIM_RESPONSE_DELAY_MAX_US - SIM_RESPONSE_DELAY_MIN_US + 1);
+    edges[n++] = (sim_edge_t){.time_us = t, .level = 0};
+    t += sim_pulse(p, SIM_RESPONSE_US);
+    edges[n++] = (sim_edge_t){.time_us = t, .level = 1};
+    t += sim_pulse(p, SIM_RESPONSE_US);
+    edges[n++] = (sim_edge_t){.time_us = t, .level = 0};
+
+    // 40 bitova, MSB prvi
+    for (size_t i = 0; i < DHT_DATA_BITS; i++)
+    {
+        bool one = data[i / 8] & (0x80 >> (i % 8));
+        t += sim_pulse(p, SIM_BIT_LOW_US);
+        edges[n++] = (sim_edge_t){.time_us = t, .level = 1};
+        t += sim_pulse(p, one ? SIM_BIT_ONE_US : SIM_BIT_ZERO_US);
+        edges[n++] = (sim_edge_t){.time_us = t, .level = 0};
+    }
+
+    // senzor pusta liniju
+    t += sim_pulse(p, SIM_BIT_LOW_US);
+    edges[n++] = (sim_edge_t){.time_us = t, .level = 1};
+
+    p->drop = SIM_MAX_EDGES;
+    if (sim_chance(p, p->config.drop_edge_permille))
+    {
+        p->drop = sim_rand(p) % n;
+        p->stats.dropped_edges++;
+    }
+    p->stats.frames++;
+
+    p->edge_count = n;
+    p->edge_next = 0;
+    sim_arm_next(p);
+}
+
+// novi start impuls prekida okvir koji jos traje
+static void sim_abort(sim_pin_t *p)
+{
+    if (p->timer)
+        esp_timer_stop(p->timer);
+    p->edge_count = 0;
+    p->line = 1;
+}
+
+esp_err_t dht_sim_attach(dht_pin_t pin, const dht_sim_config_t *config)
+{
+    sim_pin_t *p = sim_find(pin, true);
+    if (!p)
+        return ESP_ERR_NO_MEM;
+
+    if (!p->timer)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = sim_edge_cb,
+            .arg = p,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "dht_sim",
+        };
+        esp_err_t err = esp_timer_create(&args, &p->timer);
+        if (err != ESP_OK)
+            return err;
+    }
+    p->attached = true;
+    p->config = *config;
+    p->rng = config->seed ? config->seed : 1;
+    p->stats = (dht_sim_stats_t){0};
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_set_values(dht_pin_t pin, int16_t temperature, uint16_t humidity)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p || !p->attached)
+        return ESP_ERR_NOT_FOUND;
+
+    p->config.temperature = temperature;
+    p->config.humidity = humidity;
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_get_stats(dht_pin_t pin, dht_sim_stats_t *stats)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p)
+        return ESP_ERR_NOT_FOUND;
+
+    *stats = p->stats;
+    return ESP_OK;
+}
+
+esp_err_t dht_hal_pin_init(dht_pin_t pin)
+{
+    sim_pin_t *p = sim_find(pin, true);
+    if (!p)
+        return ESP_ERR_NO_MEM;
+
+    p->output = false;
+    p->level = 1;
+    return ESP_OK;
+}
+
+void dht_hal_set_output(dht_pin_t pin, bool output)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p)
+        return;
+
+    bool released = p->output && !output;
+    if (output && !p->output)
+        sim_abort(p);
+    p->output = output;
+    if (output && p->level == 0)
+        p->low_since_us = dht_hal_time_us();
+
+    // linija se vraca na pull-up; senzor odgovara ako je start bio dobar
+    if (released)
+    {
+        if (p->level == 0)
+            dht_hal_set_level(pin, 1);
+        if (p->attached && p->start_seen)
+            sim_respond(p);
+        p->start_seen = false;
+    }
+}
+
+void dht_hal_set_level(dht_pin_t pin, int level)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p)
+        return;
+
+    int64_t now = dht_hal_time_us();
+    if (p->output && p->level != 0 && level == 0)
+    {
+        p->low_since_us = now;
+    }
+    else if (p->level == 0 && level != 0 && p->attached)
+    {
+        int64_t min_us = p->config.type == DHT_TYPE_DHT11 ? DHT11_MIN_START_US : AM2301_MIN_START_US;
+        p->start_seen = now - p->low_since_us >= min_us;
+        if (!p->start_seen)
+            p->stats.short_starts++;
+    }
+    p->level = level ? 1 : 0;
+}
+
+int dht_hal_get_level(dht_pin_t pin)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p)
+        return 1;
+    return p->output ? p->level : p->line;
+}
+
+int64_t dht_hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+esp_err_t dht_hal_edge_cb_add(dht_pin_t pin, dht_hal_edge_cb_t cb, void *arg)
+{
+    sim_pin_t *p = sim_find(pin, true);
+    if (!p)
+        return ESP_ERR_NO_MEM;
+
+    p->cb = cb;
+    p->cb_arg = arg;
+    p->edges_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t dht_hal_edge_enable(dht_pin_t pin, bool enable)
+{
+    sim_pin_t *p = sim_find(pin, false);
+    if (!p)
+        return ESP_ERR_NOT_FOUND;
+
+    p->edges_enabled = enable;
+    return ESP_OK;
+}
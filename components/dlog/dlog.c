@@ -0,0 +1,187 @@
+/* Includes */
+#include "dlog.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* ESP APIs */
+#include "esp_attr.h"
+
+/* FreeRTOS APIs */
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Defines */
+#define DLOG_RING_MASK (DLOG_RING_LEN - 1)
+#define DLOG_DRAIN_PERIOD_MS 50
+#define DLOG_DRAIN_STACK_SIZE 3072
+/* Fill level at which a producer wakes the drain task ahead of its period */
+#define DLOG_HIGH_WATER (DLOG_RING_LEN * 3 / 4)
+
+_Static_assert((DLOG_RING_LEN & DLOG_RING_MASK) == 0, "DLOG_RING_LEN must be a power of two");
+
+typedef struct {
+    /* Position this slot is ready for, stored relative to the slot index so a zeroed ring is valid */
+    atomic_uint seq;
+    uint32_t ticks;
+    const char* tag;
+    const char* fmt;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_slot_t;
+
+/* Private variables */
+static dlog_slot_t ring[DLOG_RING_LEN];
+static atomic_uint head;
+static atomic_uint tail;
+static atomic_uint dropped;
+static atomic_uint dropped_reported;
+static TaskHandle_t drain_task_handle;
+static volatile uint32_t drain_period_ms = DLOG_DRAIN_PERIOD_MS;
+
+/* Private functions */
+static inline uint32_t slot_seq(uint32_t idx) {
+    return atomic_load_explicit(&ring[idx].seq, memory_order_acquire) + idx;
+}
+
+static inline void slot_publish(uint32_t idx, uint32_t seq) {
+    atomic_store_explicit(&ring[idx].seq, seq - idx, memory_order_release);
+}
+
+static bool dlog_pop(dlog_slot_t* out) {
+    uint32_t pos = atomic_load_explicit(&tail, memory_order_relaxed);
+
+    for (;;) {
+        uint32_t idx = pos & DLOG_RING_MASK;
+        int32_t diff = (int32_t)(slot_seq(idx) - (pos + 1));
+
+        if (diff < 0) {
+            return false;
+        }
+        if (diff == 0 && atomic_compare_exchange_weak_explicit(&tail, &pos, pos + 1, memory_order_relaxed,
+                                                               memory_order_relaxed)) {
+            out->ticks = ring[idx].ticks;
+            out->tag = ring[idx].tag;
+            out->fmt = ring[idx].fmt;
+            for (int i = 0; i < DLOG_MAX_ARGS; i++) {
+                out->args[i] = ring[idx].args[i];
+            }
+            slot_publish(idx, pos + DLOG_RING_LEN);
+            return true;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void dlog_print(const dlog_slot_t* e) {
+    const uint32_t* a = e->args;
+
+    printf("D (%lu) %s: ", (unsigned long)(e->ticks * portTICK_PERIOD_MS), e->tag);
+    printf(e->fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+    putchar('\n');
+}
+
+static void IRAM_ATTR dlog_wake_drain(void) {
+    TaskHandle_t task = drain_task_handle;
+
+    if (task == NULL) {
+        return;
+    }
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(task);
+    }
+}
+
+static void dlog_drain_task(void* param) {
+    for (;;) {
+        dlog_flush();
+        ulTaskNotifyTake(pdTRUE, drain_period_ms != 0 ? pdMS_TO_TICKS(drain_period_ms) : portMAX_DELAY);
+    }
+}
+
+/* Public functions */
+void IRAM_ATTR dlog_write(const char* tag, const char* fmt, const uint32_t args[DLOG_MAX_ARGS]) {
+    uint32_t pos = atomic_load_explicit(&head, memory_order_relaxed);
+    uint32_t idx;
+
+    for (;;) {
+        int32_t diff;
+
+        idx = pos & DLOG_RING_MASK;
+        diff = (int32_t)(slot_seq(idx) - pos);
+        if (diff < 0) {
+            /* Slot still holds a line from the previous lap */
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+        if (diff == 0 && atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed,
+                                                               memory_order_relaxed)) {
+            break;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+
+    ring[idx].ticks = xPortInIsrContext() ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+    ring[idx].tag = tag;
+    ring[idx].fmt = fmt;
+    for (int i = 0; i < DLOG_MAX_ARGS; i++) {
+        ring[idx].args[i] = args[i];
+    }
+    slot_publish(idx, pos + 1);
+
+    /* A burst between drains: empty the ring before it overflows */
+    if (pos + 1 - atomic_load_explicit(&tail, memory_order_relaxed) == DLOG_HIGH_WATER) {
+        dlog_wake_drain();
+    }
+}
+
+int dlog_start(unsigned priority) {
+    if (drain_task_handle != NULL) {
+        return 0;
+    }
+    if (xTaskCreate(dlog_drain_task, "dlog", DLOG_DRAIN_STACK_SIZE, NULL, priority, &drain_task_handle) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+size_t dlog_flush(void) {
+    dlog_slot_t e;
+    size_t lines = 0;
+
+    uint32_t now_dropped;
+    uint32_t reported;
+
+    while (dlog_pop(&e)) {
+        dlog_print(&e);
+        lines++;
+    }
+
+    /* Whoever drains first reports what was lost since the last report */
+    now_dropped = dlog_dropped();
+    reported = atomic_exchange_explicit(&dropped_reported, now_dropped, memory_order_relaxed);
+    if (now_dropped != reported) {
+        printf("W dlog: %lu lines dropped\n", (unsigned long)(now_dropped - reported));
+    }
+    return lines;
+}
+
+uint32_t dlog_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+void dlog_set_drain_period(uint32_t period_ms) {
+    drain_period_ms = period_ms;
+    if (drain_task_handle != NULL) {
+        xTaskNotifyGive(drain_task_handle);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+/*
+ * Deferred binary logging for hot paths.
+ *
+ * A call site stores the address of its format string, a tag and up to
+ * DLOG_MAX_ARGS raw 32 bit words in a fixed size ring slot. Nothing is
+ * formatted at the call site: a low priority drain task pops the slots and
+ * runs printf on them later, so a log line costs a slot reservation and a
+ * few stores instead of a formatted, locked UART write.
+ *
+ * The ring is a bounded lock free multi producer queue (per slot sequence
+ * numbers, one compare and swap to reserve). Producers never block; when
+ * the ring is full the entry is dropped and counted, and the next drain
+ * prints how many were lost. The producer that fills the ring to three
+ * quarters wakes the drain task early, whatever its period.
+ *
+ * Arguments are copied by value, so:
+ *   - the format string and any %s argument must have static storage,
+ *     pass strings through DLOG_STR()
+ *   - no floating point, log fixed point values instead
+ *   - at most DLOG_MAX_ARGS conversions, each one 32 bit wide
+ *
+ * Safe to call from tasks and from ISRs placed in IRAM, not from inside a
+ * critical section, since reaching the high-water mark notifies a task.
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+#define DLOG_MAX_ARGS 6
+#ifndef DLOG_RING_LEN
+#define DLOG_RING_LEN 64 /* power of two */
+#endif
+
+/* Pass a string with static storage as a %s argument */
+#define DLOG_STR(s) ((uint32_t)(uintptr_t)(s))
+
+/* Six bytes as arguments for DLOG_MAC_FMT */
+#define DLOG_MAC_FMT "%02x:%02x:%02x:%02x:%02x:%02x"
+#define DLOG_MAC(m) (m)[0], (m)[1], (m)[2], (m)[3], (m)[4], (m)[5]
+
+/* Queue a log line; missing arguments are zero */
+#define DLOG(tag, fmt, ...) dlog_write((tag), (fmt), (const uint32_t[DLOG_MAX_ARGS]){__VA_ARGS__})
+
+/* Public function declarations */
+void dlog_write(const char* tag, const char* fmt, const uint32_t args[DLOG_MAX_ARGS]);
+/* Start the drain task; lines queued before this are kept until then */
+int dlog_start(unsigned priority);
+/* Format everything queued so far on the calling task and report drops, returns lines printed */
+size_t dlog_flush(void);
+/* How often the drain task wakes up; 0 leaves draining to dlog_flush callers and the high-water mark */
+void dlog_set_drain_period(uint32_t period_ms);
+uint32_t dlog_dropped(void);
+
+#endif  // DLOG_H
@@ -0,0 +1,45 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/*
+ * Latest value handoff from one writer to any number of readers.
+ *
+ * A latched seqlock: the value is kept in two slots and a sequence counter
+ * selects the one readers copy from. The writer bumps the counter, updates
+ * the slot readers just left, bumps it again and updates the other one.
+ * A reader copies the selected slot and retries only if the counter moved
+ * meanwhile, so it always ends with a consistent copy and never waits for
+ * a writer that was preempted halfway through an update.
+ *
+ * Neither side takes a lock or blocks. Writers must be serialized by the
+ * caller; in practice each instance has a single producer task.
+ *
+ *     static sample_t latest_slots[2];
+ *     static seqlock_t latest = SEQLOCK_INIT(latest_slots);
+ *
+ *     seqlock_write(&latest, &sample);            producer
+ *     if (seqlock_read(&latest, &copy)) { ... }   any consumer
+ */
+
+/* Includes */
+/* STD APIs */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    atomic_uint seq;
+    void* slots;
+    size_t size;
+} seqlock_t;
+
+/* slots is an array of two values of the published type */
+#define SEQLOCK_INIT(slots) \
+    { .seq = 0, .slots = (slots), .size = sizeof((slots)[0]) }
+
+/* Public function declarations */
+void seqlock_write(seqlock_t* lock, const void* value);
+/* Copy the latest value, false if nothing was published yet */
+bool seqlock_read(seqlock_t* lock, void* value);
+
+#endif  // SEQLOCK_H
@@ -0,0 +1,39 @@
+/* Includes */
+#include "seqlock.h"
+
+#include <string.h>
+
+/* Private functions */
+static inline void* slot(seqlock_t* lock, unsigned idx) {
+    return (char*)lock->slots + (idx & 1) * lock->size;
+}
+
+/* Public functions */
+void seqlock_write(seqlock_t* lock, const void* value) {
+    unsigned seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+
+    /* Odd: readers move to slot 1 while slot 0 is updated */
+    atomic_store_explicit(&lock->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    memcpy(slot(lock, 0), value, lock->size);
+
+    /* Even: readers move back to slot 0 while slot 1 catches up */
+    atomic_thread_fence(memory_order_seq_cst);
+    atomic_store_explicit(&lock->seq, seq + 2, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    memcpy(slot(lock, 1), value, lock->size);
+}
+
+bool seqlock_read(seqlock_t* lock, void* value) {
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&lock->seq, memory_order_acquire);
+        if (seq < 2) {
+            return false;
+        }
+        memcpy(value, slot(lock, seq), lock->size);
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&lock->seq, memory_order_relaxed) != seq);
+    return true;
+}
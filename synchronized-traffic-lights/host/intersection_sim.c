@@ -0,0 +1,355 @@
+#include "intersection_sim.h"
+
+#include <string.h>
+
+#include "clock_sync.h"
+#include "intersection.h"
+#include "reliable.h"
+
+#define SIM_MAX_FRAMES 256
+
+typedef enum { FRAME_HELLO, FRAME_PHASE, FRAME_SYNC, FRAME_ACK } sim_frame_type_t;
+
+typedef struct {
+    int64_t deliver_us;  // true time
+    uint8_t src;
+    uint8_t dst;
+    uint8_t type;
+    uint16_t seq;
+    bool ack_req;
+    uint8_t ack_dst;  // FRAME_ACK
+    isect_phase_t phase;
+    int32_t lead_us;  // FRAME_PHASE, as msg_phase_t
+    int64_t t1, t2, t3;
+} sim_frame_t;
+
+typedef struct {
+    isect_node_t isect;
+    bool alive;
+    uint8_t mac[6];
+    int64_t clock_offset_us;
+    int32_t clock_drift_ppb;
+
+    clock_sync_t sync;
+    uint8_t sync_mac[6];  // leader sync is kept against
+    int64_t hello_t1;
+    int64_t one_way_us;
+
+    reliable_t rel;
+    uint16_t phase_seq;  // of the last PHASE sent, reused by the repeats
+
+    bool pending;
+    isect_light_t pending_light;
+    int64_t pending_us;         // local clock
+    int64_t pending_target_us;  // true time it should fire at
+    bool pending_unsynced;
+    isect_light_t shown;
+} sim_node_t;
+
+typedef struct {
+    sim_node_t nodes[ISECT_MAX_NODES];
+    sim_frame_t frames[SIM_MAX_FRAMES];
+    uint32_t frame_count;
+    uint64_t error_total_us;
+    uint32_t error_count;
+    uint64_t unsynced_error_total_us;
+    uint32_t rng;
+} sim_t;
+
+static uint32_t sim_random(sim_t* sim) {
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return x;
+}
+
+static int64_t local_us(const sim_node_t* n, int64_t true_us) {
+    return true_us + n->clock_offset_us + true_us * n->clock_drift_ppb / 1000000000;
+}
+
+static int64_t true_us(const sim_node_t* n, int64_t local) {
+    int64_t t = local - n->clock_offset_us;
+    return t - t * n->clock_drift_ppb / 1000000000;
+}
+
+static void send(sim_t* sim, const isect_sim_config_t* config, const sim_frame_t* frame, int64_t now_us,
+                 isect_sim_result_t* result) {
+    result->messages++;
+    for (uint8_t dst = 0; dst < config->nodes; dst++) {
+        if (dst == frame->src || sim->frame_count >= SIM_MAX_FRAMES || sim_random(sim) % 1000 < config->loss_permille) {
+            continue;
+        }
+        sim_frame_t* f = &sim->frames[sim->frame_count++];
+        *f = *frame;
+        f->dst = dst;
+        f->deliver_us = now_us + config->latency_us + (config->jitter_us ? sim_random(sim) % config->jitter_us : 0);
+    }
+}
+
+static sim_node_t* find_node(sim_t* sim, const uint8_t mac[6]) {
+    for (int i = 0; i < ISECT_MAX_NODES; i++) {
+        if (memcmp(sim->nodes[i].mac, mac, 6) == 0) {
+            return &sim->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+// Ground truth: true time at which the leader's clock reads start_ms
+static int64_t start_true_us(sim_t* sim, const sim_node_t* n, uint32_t start_ms, int64_t now_us) {
+    const sim_node_t* leader = find_node(sim, n->isect.members[n->isect.leader].mac);
+    return true_us(leader, clock_sync_local_at_ms(NULL, start_ms, local_us(leader, now_us)));
+}
+
+// Leader: how far ahead the step start is, negative once it has begun
+static int32_t phase_lead_us(const isect_phase_t* phase, int64_t now_local) {
+    return (int32_t)(clock_sync_local_at_ms(NULL, phase->start_ms, now_local) - now_local);
+}
+
+// What the controller task does with an isect_action_t; rx_phase is the PHASE that caused it, if any
+static void handle_action(sim_t* sim, const isect_sim_config_t* config, uint8_t i, const isect_action_t* action,
+                          const sim_frame_t* rx_phase, int64_t now_us, isect_sim_result_t* result) {
+    sim_node_t* n = &sim->nodes[i];
+    int64_t now_local = local_us(n, now_us);
+    bool synced = isect_is_leader(&n->isect) || n->sync.valid;
+
+    if (!isect_is_leader(&n->isect)) {
+        const uint8_t* leader = n->isect.members[n->isect.leader].mac;
+        if (memcmp(leader, n->sync_mac, 6) != 0) {
+            memcpy(n->sync_mac, leader, 6);
+            clock_sync_reset(&n->sync);
+        }
+    }
+
+    if (action->send_phase) {
+        sim_frame_t f = {.src = i, .type = FRAME_PHASE, .phase = action->phase};
+        f.lead_us = phase_lead_us(&f.phase, now_local);
+        if (config->reliable) {
+            uint8_t to[ISECT_MAX_NODES][6];
+            for (uint8_t m = 1; m < n->isect.count; m++) {
+                memcpy(to[m - 1], n->isect.members[m].mac, 6);
+            }
+            f.seq = n->phase_seq = reliable_next_seq(&n->rel);
+            f.ack_req = true;
+            reliable_track(&n->rel, f.seq, (const uint8_t*)&action->phase, sizeof(isect_phase_t), to,
+                           (uint8_t)(n->isect.count - 1), (uint32_t)(now_local / 1000));
+        } else {
+            isect_confirm(&n->isect);  // open loop
+        }
+        result->steps++;
+        if (action->phase.step == ISECT_STEP_GREEN) {
+            result->greens++;
+        }
+        if (config->kill_leader_at_ms != 0 && now_us / 1000 > config->kill_leader_at_ms && result->takeover_ms == 0) {
+            result->takeover_ms = (uint32_t)(now_us / 1000 - config->kill_leader_at_ms);
+        }
+        send(sim, config, &f, now_us, result);
+    }
+
+    if (!action->light_changed) {
+        return;
+    }
+    n->pending = false;
+    if (action->scheduled && (synced || rx_phase != NULL)) {
+        int64_t target = start_true_us(sim, n, action->start_ms, now_us);
+        int64_t at;
+
+        if (synced) {
+            at = clock_sync_local_at_ms(isect_is_leader(&n->isect) ? NULL : &n->sync, action->start_ms, now_local);
+        } else {
+            // Like the firmware: lead_us after the send, taken as one_way_us before arrival
+            at = local_us(n, rx_phase->deliver_us) + rx_phase->lead_us - n->one_way_us;
+        }
+        if (at > now_local) {
+            n->pending = true;
+            n->pending_light = action->light;
+            n->pending_us = at;
+            n->pending_target_us = target;
+            n->pending_unsynced = !synced;
+            return;
+        }
+        result->late++;
+        if (now_us - target > (int64_t)result->max_late_ms * 1000) {
+            result->max_late_ms = (uint32_t)((now_us - target) / 1000);
+        }
+    }
+    n->shown = action->light;
+}
+
+static void deliver(sim_t* sim, const isect_sim_config_t* config, const sim_frame_t* f, int64_t now_us,
+                    isect_sim_result_t* result) {
+    sim_node_t* n = &sim->nodes[f->dst];
+    uint32_t now_ms = (uint32_t)(local_us(n, now_us) / 1000);
+    int64_t rx_local = local_us(n, f->deliver_us);  // stamped in the receive callback
+    isect_action_t action;
+    bool accepted;
+
+    switch (f->type) {
+        case FRAME_HELLO:
+            isect_on_hello(&n->isect, sim->nodes[f->src].mac, ISECT_GROUP_OWN, now_ms, &action);
+            handle_action(sim, config, f->dst, &action, NULL, now_us, result);
+            if (isect_is_leader(&n->isect)) {
+                sim_frame_t reply = {.src = f->dst, .type = FRAME_SYNC, .t1 = f->t1, .t2 = rx_local};
+                reply.t3 = local_us(n, now_us);
+                send(sim, config, &reply, now_us, result);
+            }
+            break;
+
+        case FRAME_PHASE:
+            // Repeats are not sequenced; isect_on_phase takes the same step twice anyway
+            if (!f->ack_req || reliable_accept(&n->rel, sim->nodes[f->src].mac, f->seq)) {
+                accepted = isect_on_phase(&n->isect, sim->nodes[f->src].mac, &f->phase, now_ms, &action);
+                handle_action(sim, config, f->dst, &action, f, now_us, result);
+            } else {
+                accepted = isect_has_phase(&n->isect, sim->nodes[f->src].mac, &f->phase);
+            }
+            // Like the firmware: only a step this head follows is acknowledged
+            if (f->ack_req && accepted) {
+                sim_frame_t ack = {.src = f->dst, .type = FRAME_ACK, .seq = f->seq, .ack_dst = f->src};
+                send(sim, config, &ack, now_us, result);
+            }
+            break;
+
+        case FRAME_ACK:
+            if (f->ack_dst == f->dst && reliable_on_ack(&n->rel, sim->nodes[f->src].mac, f->seq)) {
+                isect_confirm(&n->isect);
+            }
+            break;
+
+        case FRAME_SYNC:
+            // Replies are broadcast; only the one answering this node's last HELLO counts
+            if (f->t1 == n->hello_t1 && memcmp(sim->nodes[f->src].mac, n->sync_mac, 6) == 0) {
+                clock_sync_exchange(&n->sync, f->t1, f->t2, f->t3, rx_local);
+                n->one_way_us = clock_sync_one_way_us(&n->sync);
+            }
+            break;
+    }
+}
+
+void isect_simulate(const isect_sim_config_t* config, isect_sim_result_t* result) {
+    static sim_t sim;
+    const isect_timing_t timing = ISECT_TIMING_DEFAULT;
+    isect_action_t action;
+
+    memset(&sim, 0, sizeof(sim));
+    memset(result, 0, sizeof(*result));
+    sim.rng = config->seed ? config->seed : 1;
+
+    for (uint8_t i = 0; i < config->nodes && i < ISECT_MAX_NODES; i++) {
+        sim_node_t* n = &sim.nodes[i];
+        uint8_t mac[6] = {0x24, 0x0a, 0xc4, (uint8_t)(sim_random(&sim)), (uint8_t)(sim_random(&sim)), i};
+        uint32_t drift_range = 2 * config->max_drift_ppm * 1000 + 1;
+
+        memcpy(n->mac, mac, 6);
+        n->clock_offset_us = sim_random(&sim) % 5000000;  // booted up to 5 s apart
+        n->clock_drift_ppb = (int32_t)(sim_random(&sim) % drift_range) - (int32_t)(config->max_drift_ppm * 1000);
+        isect_init(&n->isect, mac, ISECT_GROUP_OWN, &timing, (uint32_t)(local_us(n, 0) / 1000));
+        n->shown = n->isect.light;
+        n->one_way_us = CLOCK_SYNC_DEFAULT_ONE_WAY_US;
+        n->alive = true;
+        reliable_init(&n->rel, (uint16_t)sim_random(&sim));
+    }
+
+    for (uint32_t t = 0; t < config->duration_ms; t++) {
+        int64_t now_us = (int64_t)t * 1000;
+
+        if (config->kill_leader_at_ms != 0 && t == config->kill_leader_at_ms) {
+            for (uint8_t i = 0; i < config->nodes; i++) {
+                if (sim.nodes[i].alive && isect_is_leader(&sim.nodes[i].isect)) {
+                    sim.nodes[i].alive = false;
+                }
+            }
+        }
+
+        // Deliver frames that are due
+        uint32_t burst[ISECT_MAX_NODES] = {0};
+        for (uint32_t k = 0; k < sim.frame_count;) {
+            sim_frame_t f = sim.frames[k];
+            if (f.deliver_us > now_us) {
+                k++;
+                continue;
+            }
+            sim.frames[k] = sim.frames[--sim.frame_count];
+            if (sim.nodes[f.dst].alive) {
+                if (++burst[f.dst] > result->max_rx_burst) {
+                    result->max_rx_burst = burst[f.dst];
+                }
+                deliver(&sim, config, &f, now_us, result);
+            }
+        }
+
+        for (uint8_t i = 0; i < config->nodes; i++) {
+            sim_node_t* n = &sim.nodes[i];
+            int64_t now_local = local_us(n, now_us);
+            uint32_t now_ms = (uint32_t)(now_local / 1000);
+            isect_phase_t phase;
+            const uint8_t* frame;
+            uint8_t len;
+
+            if (!n->alive) {
+                continue;
+            }
+            // The switch timer; it fires at its exact local time, so its true time is known
+            if (n->pending && now_local >= n->pending_us) {
+                n->pending = false;
+                int64_t error = true_us(n, n->pending_us) - n->pending_target_us;
+                uint32_t abs_error = (uint32_t)(error < 0 ? -error : error);
+                n->shown = n->pending_light;
+                if (n->pending_unsynced) {
+                    result->unsynced++;
+                    sim.unsynced_error_total_us += abs_error;
+                    if (abs_error > result->max_unsynced_error_us) {
+                        result->max_unsynced_error_us = abs_error;
+                    }
+                } else {
+                    sim.error_total_us += abs_error;
+                    sim.error_count++;
+                    if (abs_error > result->max_error_us) {
+                        result->max_error_us = abs_error;
+                    }
+                }
+            }
+            // HELLO ticks staggered by node; the leader repeats its last step with it
+            if ((t + i * 97) % ISECT_HELLO_PERIOD_MS == 0) {
+                sim_frame_t hello = {.src = i, .type = FRAME_HELLO, .t1 = now_local};
+                n->hello_t1 = now_local;
+                send(&sim, config, &hello, now_us, result);
+                if (isect_current_phase(&n->isect, &phase)) {
+                    sim_frame_t f = {.src = i, .type = FRAME_PHASE, .seq = n->phase_seq, .phase = phase};
+                    f.lead_us = phase_lead_us(&phase, now_local);
+                    send(&sim, config, &f, now_us, result);
+                }
+            }
+            if (reliable_poll(&n->rel, now_ms, &frame, &len)) {
+                sim_frame_t f = {.src = i, .type = FRAME_PHASE, .seq = n->rel.seq, .ack_req = true};
+                memcpy(&f.phase, frame, len);
+                f.lead_us = phase_lead_us(&f.phase, now_local);
+                send(&sim, config, &f, now_us, result);
+            }
+            isect_poll(&n->isect, now_ms, &action);
+            handle_action(&sim, config, i, &action, NULL, now_us, result);
+        }
+
+        // Safety: at most one head off red. Heads that all flash yellow agree that nobody drives;
+        // one flashing next to a green or yellow is a partitioned head that does not know.
+        uint8_t not_red = 0;
+        uint8_t coloured = 0;
+        for (uint8_t i = 0; i < config->nodes; i++) {
+            isect_light_t light = sim.nodes[i].shown;
+            if (sim.nodes[i].alive && light != ISECT_LIGHT_RED) {
+                not_red++;
+                if (light != ISECT_LIGHT_FLASH_YELLOW) {
+                    coloured++;
+                }
+            }
+        }
+        if (not_red > 1 && coloured > 0) {
+            result->conflicts++;
+        }
+    }
+
+    result->avg_error_us = sim.error_count ? (uint32_t)(sim.error_total_us / sim.error_count) : 0;
+    result->avg_unsynced_error_us = result->unsynced ? (uint32_t)(sim.unsynced_error_total_us / result->unsynced) : 0;
+}
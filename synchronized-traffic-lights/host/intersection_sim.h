@@ -0,0 +1,56 @@
+#ifndef INTERSECTION_SIM_H
+#define INTERSECTION_SIM_H
+
+/*
+ * Host simulation of the intersection protocol.
+ *
+ * Runs N isect_node_t instances in simulated time, 1 ms per step, over a
+ * broadcast medium with a base latency, random extra delay and random
+ * loss, optionally killing the leader partway. Every node is its own plan
+ * entry and has its own clock with a random offset and drift. Followers
+ * synchronise to the leader with clock_sync.h over HELLO / SYNC, and every
+ * head switches at the announced start time converted to its own clock,
+ * like the firmware does. Until the first exchange a follower times the
+ * switch from the PHASE lead_us and its arrival instead. With reliable set, PHASE is acknowledged and
+ * retransmitted through reliable.h.
+ *
+ * Checked on every step: no two heads show anything but red at the same
+ * time. Flashing yellow counts as soon as another head shows a colour, so
+ * only heads that flash together are excepted. Every switch is compared
+ * in true time with the moment the leader's clock reads the start time.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t nodes;
+    uint32_t duration_ms;
+    uint32_t latency_us;
+    uint32_t jitter_us;  // extra delay, uniform in [0, jitter_us)
+    uint16_t loss_permille;
+    uint32_t max_drift_ppm;      // clocks drift uniformly in +-max_drift_ppm
+    uint32_t kill_leader_at_ms;  // 0: never
+    bool reliable;               // ACK and retransmit PHASE like the firmware
+    uint32_t seed;
+} isect_sim_config_t;
+
+typedef struct {
+    uint32_t steps;      // PHASE steps driven
+    uint32_t greens;     // GREEN steps driven
+    uint32_t conflicts;  // ms with two heads not red, flashing yellow next to a colour included
+    uint32_t messages;   // frames sent
+    uint32_t avg_error_us;  // switch on time vs. the true time the leader clock reads start_ms, with clock sync
+    uint32_t max_error_us;  // up to jitter_us / 2: the up and down delays of the exchange sync picked can differ
+    uint32_t late;  // switches after the start time because every copy of the announcement was lost
+    uint32_t max_late_ms;
+    uint32_t unsynced;  // switches timed by PHASE lead_us because the clock was not synced to this leader yet
+    uint32_t avg_unsynced_error_us;  // those are off by the radio delay's difference from the estimate
+    uint32_t max_unsynced_error_us;
+    uint32_t takeover_ms;  // leader killed -> next step driven by the new leader
+    uint32_t max_rx_burst;  // most frames delivered to one head in one 1 ms step, sizes ESPNOW_RX_POOL_SIZE
+} isect_sim_result_t;
+
+void isect_simulate(const isect_sim_config_t* config, isect_sim_result_t* result);
+
+#endif  // INTERSECTION_SIM_H
@@ -0,0 +1,109 @@
+// Runs isect_simulate for 2..8 heads, with reliable PHASE like the firmware and open loop, and prints one row per run.
+// Exits with 1 if any reliable run had two heads off red at the same time, so it doubles as a regression test.
+// Open loop has no ACKs and no safety guarantee; its rows are only there for comparison.
+//
+//   intersection_sim [duration_s] [loss_permille] [seed]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "intersection.h"
+#include "intersection_sim.h"
+
+#define DEFAULT_DURATION_S 600
+#define DEFAULT_LOSS_PERMILLE 100
+#define DEFAULT_SEED 1
+#define LATENCY_US 1500
+#define JITTER_US 3000
+#define MAX_DRIFT_PPM 40
+
+// Runs that once failed, kept as they were found
+static const isect_sim_config_t regressions[] = {
+    // A head ACKed a PHASE from a leader it does not follow, so that leader moved on: 678 ms of conflicts
+    {.nodes = 4, .duration_ms = 600000, .latency_us = 1000, .jitter_us = 500, .loss_permille = 300,
+     .max_drift_ppm = 40, .kill_leader_at_ms = 300000, .reliable = true, .seed = 777},
+    // A repeat of YELLOW overtaken by ALL_RED on the air brought the colour back: 1 ms of conflict
+    {.nodes = 3, .duration_ms = 900000, .latency_us = 1000, .jitter_us = 3000, .loss_permille = 100,
+     .max_drift_ppm = 20, .kill_leader_at_ms = 450000, .reliable = true, .seed = 1484},
+    // The leader lost every member's HELLOs and flashed yellow while a follower kept its green
+    {.nodes = 4, .duration_ms = 900000, .latency_us = 1000, .jitter_us = 3000, .loss_permille = 300,
+     .max_drift_ppm = 10, .kill_leader_at_ms = 450000, .reliable = true, .seed = 1080},
+    {.nodes = 4, .duration_ms = 900000, .latency_us = 1000, .jitter_us = 3000, .loss_permille = 300,
+     .max_drift_ppm = 30, .kill_leader_at_ms = 450000, .reliable = true, .seed = 1383},
+};
+
+static void print_header(void) {
+    printf("%5s %5s %8s %9s %8s %13s %5s %8s %17s %8s %5s\n", "nodes", "loss", "reliable", "conflicts", "frames/s",
+           "err avg/max", "late", "max late", "unsynced err", "takeover", "burst");
+}
+
+static bool run_config(const isect_sim_config_t* config) {
+    uint32_t duration_s = config->duration_ms / 1000;
+    isect_sim_result_t r;
+    char error[16];
+    char unsynced[24];
+    char takeover[16];
+
+    isect_simulate(config, &r);
+    snprintf(error, sizeof(error), "%u/%u us", (unsigned)r.avg_error_us, (unsigned)r.max_error_us);
+    snprintf(unsynced, sizeof(unsynced), "%ux %u/%u us", (unsigned)r.unsynced, (unsigned)r.avg_unsynced_error_us,
+             (unsigned)r.max_unsynced_error_us);
+    // Two heads: the survivor is alone and stays red, nobody takes over
+    if (r.takeover_ms != 0) {
+        snprintf(takeover, sizeof(takeover), "%.1f s", r.takeover_ms / 1000.0);
+    } else {
+        snprintf(takeover, sizeof(takeover), "-");
+    }
+    printf("%5u %4.1f%% %8s %9u %8.1f %13s %5u %5u ms %17s %8s %5u\n", config->nodes, config->loss_permille / 10.0,
+           config->reliable ? "yes" : "no",
+           (unsigned)r.conflicts, (double)r.messages / duration_s, error, (unsigned)r.late, (unsigned)r.max_late_ms,
+           unsynced, takeover, (unsigned)r.max_rx_burst);
+    return r.conflicts == 0;
+}
+
+static bool run(uint8_t nodes, uint16_t loss_permille, bool reliable, uint32_t duration_s, uint32_t seed) {
+    const isect_sim_config_t config = {
+        .nodes = nodes,
+        .duration_ms = duration_s * 1000,
+        .latency_us = LATENCY_US,
+        .jitter_us = JITTER_US,
+        .loss_permille = loss_permille,
+        .max_drift_ppm = MAX_DRIFT_PPM,
+        .kill_leader_at_ms = duration_s * 1000 / 2,
+        .reliable = reliable,
+        .seed = seed,
+    };
+
+    return run_config(&config);
+}
+
+int main(int argc, char** argv) {
+    uint32_t duration_s = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : DEFAULT_DURATION_S;
+    uint16_t loss = argc > 2 ? (uint16_t)strtoul(argv[2], NULL, 10) : DEFAULT_LOSS_PERMILLE;
+    uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : DEFAULT_SEED;
+    bool ok = true;
+
+    printf("%u s per run, leader killed halfway, %u us + up to %u us per hop, clocks +-%u ppm, seed %u\n",
+           (unsigned)duration_s, LATENCY_US, JITTER_US, MAX_DRIFT_PPM, (unsigned)seed);
+    print_header();
+    for (uint8_t nodes = 2; nodes <= ISECT_MAX_NODES; nodes++) {
+        ok &= run(nodes, 0, true, duration_s, seed);
+    }
+    for (uint8_t nodes = 2; nodes <= ISECT_MAX_NODES; nodes++) {
+        ok &= run(nodes, loss, true, duration_s, seed);
+    }
+    printf("regressions\n");
+    for (size_t i = 0; i < sizeof(regressions) / sizeof(regressions[0]); i++) {
+        ok &= run_config(&regressions[i]);
+    }
+    printf("open loop, not checked\n");
+    for (uint8_t nodes = 2; nodes <= ISECT_MAX_NODES; nodes++) {
+        run(nodes, 0, false, duration_s, seed);
+        run(nodes, loss, false, duration_s, seed);
+    }
+    if (!ok) {
+        printf("FAIL: two heads off red at once in a reliable run\n");
+    }
+    return ok ? 0 : 1;
+}
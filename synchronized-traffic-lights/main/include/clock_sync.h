@@ -0,0 +1,73 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+/*
+ * Follower side clock synchronisation against one reference clock.
+ *
+ * Every exchange is NTP style, four timestamps in microseconds:
+ *   t1  follower sends a request      (local clock)
+ *   t2  reference receives it         (reference clock)
+ *   t3  reference sends the reply     (reference clock)
+ *   t4  follower receives the reply   (local clock)
+ * offset = ((t2 - t1) + (t3 - t4)) / 2, delay = (t4 - t1) - (t3 - t2).
+ *
+ * The last CLOCK_SYNC_WINDOW exchanges are kept and the one with the
+ * smallest delay gives the offset, because queueing only ever adds delay,
+ * and usually on one side only. Drift is the slope between that sample
+ * and an earlier best sample at least CLOCK_SYNC_DRIFT_SPAN_US before it,
+ * smoothed over successive spans: a slope over a few seconds would be
+ * mostly jitter.
+ *
+ * Timestamps should be taken as close to the radio as possible: t2 and t4
+ * at reception in the Wi-Fi task, t1 and t3 right before sending.
+ *
+ * Pure C without ESP-IDF dependencies, so it also builds on a host.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CLOCK_SYNC_WINDOW 8
+#define CLOCK_SYNC_DRIFT_SPAN_US 30000000
+#define CLOCK_SYNC_DRIFT_SMOOTHING 4     // new estimates count 1/4
+#define CLOCK_SYNC_MAX_DRIFT_PPB 200000  // crystals are far better; anything above is noise
+
+// One-way delay of a short ESP-NOW broadcast, assumed until an exchange has measured it
+#define CLOCK_SYNC_DEFAULT_ONE_WAY_US 1000
+
+typedef struct {
+    int64_t local_us;   // t4
+    int64_t offset_us;  // reference - local
+    int64_t delay_us;
+} clock_sync_sample_t;
+
+typedef struct {
+    clock_sync_sample_t samples[CLOCK_SYNC_WINDOW];
+    uint8_t count;
+    uint8_t next;
+
+    // reference = local + offset_us + (local - base_local_us) * drift_ppb / 1e9
+    int64_t base_local_us;
+    int64_t offset_us;
+    int32_t drift_ppb;
+    bool valid;
+
+    // Start of the span the next drift estimate is taken over
+    int64_t anchor_local_us;
+    int64_t anchor_offset_us;
+    bool have_anchor;
+    bool have_drift;
+} clock_sync_t;
+
+// Forget everything, e.g. when the reference changes
+void clock_sync_reset(clock_sync_t* cs);
+void clock_sync_exchange(clock_sync_t* cs, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+int64_t clock_sync_to_ref(const clock_sync_t* cs, int64_t local_us);
+int64_t clock_sync_to_local(const clock_sync_t* cs, int64_t ref_us);
+// Half the smallest delay in the window, CLOCK_SYNC_DEFAULT_ONE_WAY_US before the first exchange
+int64_t clock_sync_one_way_us(const clock_sync_t* cs);
+// Local time at which the 32 bit reference millisecond ref_ms starts, taken as the
+// instance of ref_ms closest to now. cs NULL means this node is the reference.
+int64_t clock_sync_local_at_ms(const clock_sync_t* cs, uint32_t ref_ms, int64_t local_now_us);
+
+#endif  // CLOCK_SYNC_H
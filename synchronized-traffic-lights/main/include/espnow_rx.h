@@ -0,0 +1,57 @@
+#ifndef ESPNOW_RX_H
+#define ESPNOW_RX_H
+
+/*
+ * ESP-NOW receive pipeline.
+ *
+ * The receive callback runs in the Wi-Fi task and must return quickly, so
+ * it only validates the frame length, copies the frame into a buffer from
+ * a fixed pool and pushes the buffer index into a lock-free single
+ * producer / single consumer ring, then wakes the consumer task with a
+ * task notification. No allocation, no locks, no logging, constant time.
+ *
+ * The consumer task takes frames with espnow_rx_take and gives each one
+ * back with espnow_rx_release. Free buffers travel back through a second
+ * ring, so the pool needs no lock either. A frame is only dropped when
+ * the whole pool is in flight; those drops and invalid frames are counted.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Power of two. The host simulation (max_rx_burst) delivers up to 13 frames to one head within
+// 1 ms with 8 heads and reliable PHASE, mostly ACKs to the leader; twice that covers a burst
+// arriving while the protocol task is still blocked on a full controller queue.
+#define ESPNOW_RX_POOL_SIZE 32
+#define ESPNOW_RX_MAX_LEN 64
+
+typedef struct {
+    uint8_t src[6];
+    uint8_t len;
+    int8_t rssi;
+    int64_t rx_us;  // esp_timer time of arrival
+    uint8_t data[ESPNOW_RX_MAX_LEN];
+} espnow_rx_frame_t;
+
+typedef struct {
+    uint32_t received;
+    uint32_t invalid;    // rejected by the length check
+    uint32_t pool_full;  // valid, but no free buffer
+    uint32_t max_in_flight;  // most buffers taken at once, the burst the pool has to absorb
+} espnow_rx_stats_t;
+
+// Called in the Wi-Fi task for every frame; must be cheap and must not block
+typedef bool (*espnow_rx_validate_t)(const uint8_t* data, int len);
+
+// Registers the ESP-NOW receive callback; frames are handed to consumer
+esp_err_t espnow_rx_init(TaskHandle_t consumer, espnow_rx_validate_t validate);
+// Consumer task only: next frame or NULL, does not block
+espnow_rx_frame_t* espnow_rx_take(void);
+void espnow_rx_release(espnow_rx_frame_t* frame);
+void espnow_rx_get_stats(espnow_rx_stats_t* stats);
+
+#endif  // ESPNOW_RX_H
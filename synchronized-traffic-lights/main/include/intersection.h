@@ -0,0 +1,163 @@
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+/*
+ * Intersection coordination for any number of signal heads.
+ *
+ * Every node broadcasts a HELLO with its MAC and signal group once per
+ * ISECT_HELLO_PERIOD_MS; that is both discovery and heartbeat. Each node
+ * keeps a membership table and drops members it has not heard from for
+ * ISECT_MEMBER_TIMEOUT_MS. The alive member with the lowest MAC is the
+ * leader; every node computes the same answer from its own table, so no
+ * election messages are needed and a dead leader is replaced after one
+ * timeout.
+ *
+ * The leader runs a cyclic phase plan over the entries of the table:
+ * heads with the same non-zero group share green, a head with group 0 is
+ * an entry of its own. Entries are served in order of their lowest MAC:
+ *   RED_YELLOW -> GREEN -> YELLOW -> ALL_RED -> next entry
+ * Each step is one broadcast PHASE message, so the traffic per phase does
+ * not grow with the number of heads. The leader repeats the current step
+ * on every HELLO tick to cover lost broadcasts. Before the next entry gets
+ * RED_YELLOW, every follower must have confirmed ALL_RED (isect_confirm,
+ * fed by ACKs); until then ALL_RED is announced again. A member that
+ * expires before confirming may still show its entry's colours, so the
+ * leader holds ALL_RED until it rejoins and confirms, or until its own
+ * fail-safe has turned it red (isect_held_t).
+ *
+ * Fail-safe: a follower that has heard no PHASE from its leader for
+ * ISECT_PHASE_TIMEOUT_MS shows red until the leader's next step; a late
+ * repeat of the step it timed out in does not bring the colour back. A
+ * PHASE older than the last one taken from the same leader is ignored, so
+ * a repeat overtaken on the air cannot bring one back either.
+ *
+ * Steps are announced ISECT_SWITCH_LEAD_MS before they start and carry
+ * their start time on the leader's millisecond clock. Every head, the
+ * leader included, switches at that time, converted to its own clock with
+ * clock_sync.h, so radio delay does not turn into skew between heads. The
+ * state machine hands out the light with the time to show it; scheduling
+ * is up to the caller.
+ *
+ * A node that has never heard another head shows flashing yellow. One
+ * that has lost all of them shows red: they may still be running the plan
+ * out of its range.
+ *
+ * Pure state machine without ESP-IDF dependencies: events and time go in,
+ * messages to send and the light to show come out, so the whole protocol
+ * runs in a host simulation (host/intersection_sim.h).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ISECT_MAX_NODES 8
+#define ISECT_HELLO_PERIOD_MS 1000
+#define ISECT_MEMBER_TIMEOUT_MS 3000
+#define ISECT_SWITCH_LEAD_MS 200  // PHASE goes out this long before the step starts
+#define ISECT_GROUP_OWN 0         // the head is a plan entry of its own
+// A follower that hears no PHASE from its leader for this long shows red
+#define ISECT_PHASE_TIMEOUT_MS (3 * ISECT_HELLO_PERIOD_MS)
+
+typedef enum {
+    ISECT_LIGHT_FLASH_YELLOW = 0,
+    ISECT_LIGHT_RED,
+    ISECT_LIGHT_RED_YELLOW,
+    ISECT_LIGHT_GREEN,
+    ISECT_LIGHT_YELLOW,
+} isect_light_t;
+
+typedef enum {
+    ISECT_STEP_RED_YELLOW = 0,
+    ISECT_STEP_GREEN,
+    ISECT_STEP_YELLOW,
+    ISECT_STEP_ALL_RED,
+    ISECT_STEP_COUNT,
+} isect_step_t;
+
+typedef struct {
+    uint32_t red_yellow_ms;
+    uint32_t green_ms;
+    uint32_t green_jitter_ms;  // green lasts green_ms + [0, jitter)
+    uint32_t yellow_ms;
+    uint32_t all_red_ms;
+} isect_timing_t;
+
+#define ISECT_TIMING_DEFAULT \
+    { .red_yellow_ms = 1000, .green_ms = 5000, .green_jitter_ms = 5000, .yellow_ms = 2000, .all_red_ms = 1000 }
+
+// Body of a PHASE broadcast: which entry is in which step
+typedef struct {
+    uint16_t cycle;     // incremented by the leader for every step
+    uint8_t step;       // isect_step_t
+    uint8_t group;      // active entry: a shared group ...
+    uint8_t mac[6];     // ... or, for ISECT_GROUP_OWN, this head
+    uint32_t duration_ms;
+    uint32_t start_ms;  // leader clock
+} isect_phase_t;
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t group;
+    uint32_t last_seen_ms;
+    bool red;    // leader: confirmed an ALL_RED since its entry was last served
+    bool asked;  // leader: was waited for by the last announced ALL_RED
+} isect_member_t;
+
+// Leader: an expired member that had not confirmed red, taken as red from clear_ms
+typedef struct {
+    uint8_t mac[6];
+    uint8_t group;
+    uint32_t clear_ms;
+} isect_held_t;
+
+typedef struct {
+    isect_timing_t timing;
+    isect_member_t members[ISECT_MAX_NODES];  // [0] is this node
+    uint8_t count;
+    uint8_t leader;  // index into members
+
+    // Leader side
+    bool driving;
+    isect_phase_t phase;
+    uint32_t step_end_ms;  // of the last announced step
+    isect_held_t held[ISECT_MAX_NODES];
+    uint8_t held_count;
+    uint32_t rng;
+
+    // What this head shows, or is about to show
+    isect_light_t light;
+    bool have_phase;
+    uint8_t phase_src[6];    // who announced phase
+    uint32_t phase_seen_ms;  // last PHASE from the leader followed
+    bool phase_expired;      // fail-safe red until the leader's next step
+    bool joined;             // has been part of an intersection since init
+} isect_node_t;
+
+typedef struct {
+    bool send_phase;  // broadcast action.phase
+    isect_phase_t phase;
+    bool light_changed;
+    isect_light_t light;
+    bool scheduled;     // show light at start_ms on the leader clock, otherwise now
+    uint32_t start_ms;
+} isect_action_t;
+
+void isect_init(isect_node_t* node, const uint8_t mac[6], uint8_t group, const isect_timing_t* timing, uint32_t now_ms);
+// HELLO from a node, including the node's own broadcasts looped back or not
+void isect_on_hello(isect_node_t* node, const uint8_t mac[6], uint8_t group, uint32_t now_ms, isect_action_t* action);
+// PHASE from src; true if src is the leader this node follows and the step was taken
+bool isect_on_phase(isect_node_t* node, const uint8_t src[6], const isect_phase_t* phase, uint32_t now_ms,
+                    isect_action_t* action);
+// A repeat of a PHASE already handled: true if it is the step this node took from its leader
+bool isect_has_phase(const isect_node_t* node, const uint8_t src[6], const isect_phase_t* phase);
+// Expire members, re-elect, advance the plan; call at least every deadline
+void isect_poll(isect_node_t* node, uint32_t now_ms, isect_action_t* action);
+// ms until isect_poll has something to do
+uint32_t isect_next_deadline_ms(const isect_node_t* node, uint32_t now_ms);
+// Leader: the last announced step reached every follower it was sent to
+void isect_confirm(isect_node_t* node);
+bool isect_is_leader(const isect_node_t* node);
+// The step the leader announced last, to repeat on the HELLO tick; false if not leading
+bool isect_current_phase(const isect_node_t* node, isect_phase_t* phase);
+
+#endif  // INTERSECTION_H
@@ -0,0 +1,84 @@
+#ifndef RELIABLE_H
+#define RELIABLE_H
+
+/*
+ * Acknowledged delivery on top of ESP-NOW broadcasts.
+ *
+ * Every node numbers the messages it wants acknowledged with its own 16
+ * bit sequence. The sender keeps the last such message together with the
+ * peers that still owe an ACK and sends it again after RELIABLE_RETRY_MS,
+ * doubling the interval each time, until everyone has answered or
+ * RELIABLE_MAX_RETRIES retransmits are spent. An ACK names the sender and
+ * the sequence it answers, so it cannot be mistaken for anything else. A
+ * newer message replaces an outstanding one; the leader only ever needs
+ * the latest phase step delivered.
+ *
+ * Receivers ACK every copy, since the ACK may be what was lost, but pass
+ * each sequence on only once. Frames sent without asking for an ACK are
+ * not sequenced. A sequence far behind the last one seen
+ * from that peer is taken as a restart of the peer, not a duplicate.
+ *
+ * The default timing puts all retransmits inside ISECT_SWITCH_LEAD_MS, so
+ * a lost announcement still arrives before the step starts.
+ *
+ * Pure C without ESP-IDF dependencies, so it also builds on a host.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RELIABLE_MAX_PEERS 8
+#define RELIABLE_MAX_FRAME 64
+#define RELIABLE_RETRY_MS 25  // then 50, 100: the last goes out 175 ms after the first
+#define RELIABLE_MAX_RETRIES 3
+#define RELIABLE_DUP_WINDOW 32  // sequences remembered per peer
+
+typedef struct {
+    uint8_t mac[6];
+    uint16_t last_seq;
+    uint32_t seen;  // bit i: last_seq - i was received
+    bool valid;
+} reliable_rx_peer_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t retransmits;
+    uint32_t delivered;  // every recipient answered
+    uint32_t gave_up;
+    uint32_t duplicates;
+} reliable_stats_t;
+
+typedef struct {
+    uint16_t tx_seq;
+
+    // Outstanding message
+    bool pending;
+    uint16_t seq;
+    uint8_t frame[RELIABLE_MAX_FRAME];
+    uint8_t len;
+    uint8_t waiting[RELIABLE_MAX_PEERS][6];
+    uint8_t waiting_count;
+    uint32_t retry_at_ms;
+    uint32_t interval_ms;
+    uint8_t retries;
+
+    reliable_rx_peer_t peers[RELIABLE_MAX_PEERS];
+    reliable_stats_t stats;
+} reliable_t;
+
+void reliable_init(reliable_t* rel, uint16_t first_seq);
+// Sequence for the next acknowledged message; put it in the frame, then reliable_track it
+uint16_t reliable_next_seq(reliable_t* rel);
+// Wait for ACKs from count peers; the frame is copied for retransmits
+void reliable_track(reliable_t* rel, uint16_t seq, const uint8_t* frame, uint8_t len, const uint8_t (*to)[6],
+                    uint8_t count, uint32_t now_ms);
+// ACK for seq from src; true when it completed the outstanding message
+bool reliable_on_ack(reliable_t* rel, const uint8_t src[6], uint16_t seq);
+// Receive side: true the first time seq arrives from src
+bool reliable_accept(reliable_t* rel, const uint8_t src[6], uint16_t seq);
+// True with the frame to send again when a retransmit is due
+bool reliable_poll(reliable_t* rel, uint32_t now_ms, const uint8_t** frame, uint8_t* len);
+// ms until reliable_poll has something to do, UINT32_MAX if nothing is outstanding
+uint32_t reliable_next_deadline_ms(const reliable_t* rel, uint32_t now_ms);
+
+#endif  // RELIABLE_H
@@ -1,60 +1,139 @@
+#include <dlog.h>
 #include <driver/gpio.h>
 #include <esp_err.h>
 #include <esp_event.h>
 #include <esp_netif.h>
 #include <esp_now.h>
+#include <esp_random.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/task.h>
+#include <freertos/timers.h>
 #include <nvs_flash.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#include "clock_sync.h"
+#include "espnow_rx.h"
+#include "intersection.h"
+#include "reliable.h"
 
 #define RED_LED_PIN GPIO_NUM_27
 #define YELLOW_LED_PIN GPIO_NUM_26
 #define GREEN_LED_PIN GPIO_NUM_25
 
+#define TAG "lights"
+
+// Heads with the same non-zero group share green; 0 makes this head an entry of its own
+#define SIGNAL_GROUP ISECT_GROUP_OWN
+
+#define BLINK_PERIOD_MS 500
+// Receive counters are logged every this many HELLO ticks, and right away when frames were dropped
+#define RX_STATS_EVERY_HELLOS 60
+
+#define CONTROLLER_QUEUE_LEN 16
+#define CONTROLLER_STACK_SIZE 4096
+#define CONTROLLER_PRIORITY 6
+#define PROTOCOL_STACK_SIZE 3072
+#define PROTOCOL_PRIORITY 7
+
 const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-uint8_t my_mac[6];
-uint8_t other_mac[6];
-bool is_master = false;
-bool role_determined = false;
-bool change_received = true;
-bool change_ack = true;
-bool yellow_on = false;
 
-TimerHandle_t heartbeat_timer = NULL;
-TimerHandle_t heartbeat_alive_timer = NULL;
-TimerHandle_t yellow_timer = NULL;
+typedef enum { MSG_HELLO = 0x01, MSG_ACK = 0x02, MSG_PHASE = 0x05, MSG_SYNC = 0x06 } msg_type_t;
 
-typedef enum { MSG_HELLO = 0x01, MSG_ACK = 0x02, MSG_CHANGE = 0x03, MSG_HEARTBEAT = 0x04 } msg_type_t;
+#define MSG_FLAG_ACK_REQ 0x01  // answer with MSG_ACK for (sender, seq)
 
 typedef struct {
     uint8_t type;       // message type
+    uint8_t flags;      // MSG_FLAG_*
+    uint16_t seq;       // sender's sequence, only meaningful with MSG_FLAG_ACK_REQ
     uint8_t payload[];  // flexible array
 } msg_header_t;
 
 typedef struct {
-    msg_header_t hdr;  // type = MSG_HELLO
+    msg_header_t hdr;  // type = MSG_HELLO, also the heartbeat
     uint8_t mac[6];
+    uint8_t group;
+    int64_t tx_us;  // t1 of a clock sync exchange with the leader
 } msg_hello_t;
 
+typedef struct {
+    msg_header_t hdr;  // type = MSG_PHASE, broadcast by the leader
+    isect_phase_t phase;
+    int32_t lead_us;  // phase start minus this send on the leader clock, for heads without clock sync yet
+} msg_phase_t;
+
+typedef struct {
+    msg_header_t hdr;  // type = MSG_SYNC, the leader's answer to a HELLO
+    uint8_t dst[6];    // broadcast, so the leader needs no peer per head
+    int64_t t1;        // HELLO tx_us
+    int64_t t2;        // HELLO arrival, leader clock
+    int64_t t3;        // this reply, leader clock
+} msg_sync_t;
+
 typedef struct {
     msg_header_t hdr;  // type = MSG_ACK
-    uint8_t mac[6];
+    uint8_t dst[6];    // sender of the acknowledged message
+    uint16_t seq;      // its hdr.seq
 } msg_ack_t;
 
-typedef struct {
-    msg_header_t hdr;  // type = MSG_SYNC
-    uint8_t flag;
-} msg_change_t;
+// Everything the controller reacts to, from the receive path and from timers
+typedef enum {
+    EVT_RX_HELLO = 0,
+    EVT_RX_PHASE,
+    EVT_RX_SYNC,
+    EVT_RX_ACK,
+    EVT_HELLO_TICK,
+    EVT_BLINK_TICK,
+    EVT_PHASE_DONE,  // isect_next_deadline_ms reached
+} ctrl_event_type_t;
+
+// Timer events reach the controller as task notification bits, so repeats coalesce and none is lost
+#define TIMER_EVENT_BIT(evt) (1u << (evt))
+// Something was queued on ctrl_queue
+#define QUEUE_EVENT_BIT (1u << 31)
 
 typedef struct {
-    msg_header_t hdr;  // type = MSG_HEARTBEAT
+    uint8_t type;
     uint8_t mac[6];
-} msg_heartbeat_t;
+    uint8_t flags;  // received hdr.flags
+    uint16_t seq;   // received hdr.seq
+    int64_t rx_us;
+    int32_t lead_us;  // EVT_RX_PHASE: msg_phase_t lead_us
+    union {
+        struct {
+            uint8_t group;
+            int64_t tx_us;
+        } hello;              // EVT_RX_HELLO
+        isect_phase_t phase;  // EVT_RX_PHASE
+        msg_sync_t sync;      // EVT_RX_SYNC
+        msg_ack_t ack;        // EVT_RX_ACK
+    };
+} ctrl_event_t;
+
+// Controller state, owned by the controller task
+static uint8_t my_mac[6];
+static isect_node_t node;
+static bool was_leader = false;
+static bool yellow_on = false;
+static clock_sync_t sync;     // against the leader, while following
+static uint8_t sync_mac[6];   // leader sync is kept against
+static int64_t hello_t1 = 0;  // tx_us of the last HELLO, matched against SYNC replies
+static reliable_t rel;
+static uint16_t phase_seq = 0;  // of the last PHASE announced, repeated on the HELLO tick
+// Radio delay for timing a PHASE before sync is valid; the last measured one outlives a change of leader
+static int64_t one_way_us = CLOCK_SYNC_DEFAULT_ONE_WAY_US;
+
+static esp_timer_handle_t switch_timer = NULL;
+static isect_light_t pending_light;  // shown by switch_timer
+
+static QueueHandle_t ctrl_queue = NULL;
+static TaskHandle_t controller = NULL;
+static TimerHandle_t hello_timer = NULL;
+static TimerHandle_t yellow_timer = NULL;
+static TimerHandle_t phase_timer = NULL;
 
 void start_wifi(void) {
     ESP_ERROR_CHECK(nvs_flash_init());  // Initialize NVS
@@ -70,245 +149,377 @@ void start_wifi(void) {
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
-void heartbeat_timer_cb(TimerHandle_t xTimer) {
-    if (role_determined) {
-        msg_heartbeat_t msg = {
-            .hdr.type = MSG_HEARTBEAT,
-        };
-        memcpy(msg.mac, my_mac, 6);
-        esp_now_send(other_mac, (uint8_t*)&msg, sizeof(msg_heartbeat_t));  // Send HEARTBEAT message
+// Timer service task: must not block; setting a bit cannot fail, unlike a send to a full queue
+void timer_event_cb(TimerHandle_t xTimer) {
+    if (controller != NULL) {
+        xTaskNotify(controller, TIMER_EVENT_BIT((uintptr_t)pvTimerGetTimerID(xTimer)), eSetBits);
     }
 }
 
-void heartbeat_alive_timer_cb(TimerHandle_t xTimer) {
-    is_master = false;
-    role_determined = false;  // Reset role determination on heartbeat timeout
-    change_received = true;
-    change_ack = true;
-    yellow_on = false;
-    if (heartbeat_alive_timer != NULL) {
-        xTimerDelete(heartbeat_alive_timer, 0);
-        heartbeat_alive_timer = NULL;
-    }
-    if (heartbeat_timer != NULL) {
-        xTimerDelete(heartbeat_timer, 0);
-        heartbeat_timer = NULL;
-    }
+static void set_lights(int red, int yellow, int green) {
+    gpio_set_level(RED_LED_PIN, red);
+    gpio_set_level(YELLOW_LED_PIN, yellow);
+    gpio_set_level(GREEN_LED_PIN, green);
+}
 
-    printf("HEARTBEAT TIMEOUT: Resetting role determination\n");
+// The leader's clock is its esp_timer in ms, so phase start times are sub-tick exact
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
 }
-void yellow_timer_cb(TimerHandle_t xTimer) {
-    yellow_on = !yellow_on;
-    gpio_set_level(YELLOW_LED_PIN, yellow_on);
+
+// Controller and esp_timer task: GPIO only, blinking is up to the controller
+static void show_light(isect_light_t light) {
+    switch (light) {
+        case ISECT_LIGHT_RED_YELLOW:
+            set_lights(1, 1, 0);
+            break;
+        case ISECT_LIGHT_GREEN:
+            set_lights(0, 0, 1);
+            break;
+        case ISECT_LIGHT_YELLOW:
+            set_lights(0, 1, 0);
+            break;
+        case ISECT_LIGHT_FLASH_YELLOW:
+            set_lights(0, 0, 0);
+            break;
+        default:
+            set_lights(1, 0, 0);
+            break;
+    }
 }
 
-void determine_role_and_configure_leds() {
-    if (memcmp(my_mac, other_mac, 6) < 0) {
-        is_master = true;
-        printf("I am MASTER\n");
+// esp_timer task: switches at the phase start, independent of controller latency
+static void switch_cb(void* arg) {
+    show_light(pending_light);
+}
+
+// Show a light now, or at the phase start time converted to this node's clock. rx_phase is the
+// PHASE that caused the action, if any.
+static void schedule_light(const isect_action_t* action, bool leader, const ctrl_event_t* rx_phase) {
+    int64_t now = esp_timer_get_time();
+    int64_t at;
+
+    esp_timer_stop(switch_timer);  // Fails harmlessly when not running
+    if (action->light == ISECT_LIGHT_FLASH_YELLOW) {
+        yellow_on = false;
+        xTimerStart(yellow_timer, 0);
     } else {
-        is_master = false;
-        printf("I am SLAVE\n");
-    }
-    gpio_set_level(RED_LED_PIN, 1);
-    gpio_set_level(YELLOW_LED_PIN, 0);
-    gpio_set_level(GREEN_LED_PIN, 0);
-    role_determined = true;
-
-    // Delete old timers if they exist
-    if (heartbeat_timer != NULL) {
-        xTimerDelete(heartbeat_timer, 0);
+        xTimerStop(yellow_timer, 0);
     }
-    if (heartbeat_alive_timer != NULL) {
-        xTimerDelete(heartbeat_alive_timer, 0);
-    }
-
-    // Create new timers and store handles
-    heartbeat_timer = xTimerCreate("heartbeat_timer", pdMS_TO_TICKS(2000), pdTRUE, NULL, heartbeat_timer_cb);
-    heartbeat_alive_timer = xTimerCreate("heartbeat_alive_timer", pdMS_TO_TICKS(3000), pdTRUE, NULL, heartbeat_alive_timer_cb);
 
-    // Start timers
-    xTimerStart(heartbeat_timer, 0);
-    xTimerStart(heartbeat_alive_timer, 0);
-    xTimerStop(yellow_timer, 0);
+    if (action->scheduled && (leader || sync.valid || rx_phase != NULL)) {
+        if (leader || sync.valid) {
+            at = clock_sync_local_at_ms(leader ? NULL : &sync, action->start_ms, now);
+        } else {
+            // No clock estimate yet: the start is lead_us after the send, which was one_way_us before arrival.
+            // For the first copy of an announcement that is ISECT_SWITCH_LEAD_MS minus the radio delay.
+            at = rx_phase->rx_us + rx_phase->lead_us - one_way_us;
+        }
+        if (at > now) {
+            pending_light = action->light;
+            esp_timer_start_once(switch_timer, at - now);
+            return;
+        }
+    }
+    show_light(action->light);
 }
 
-void send_hello_broadcast() {
-    printf("Sending HELLO with MAC: %02x:%02x:%02x:%02x:%02x:%02x\n", my_mac[0], my_mac[1], my_mac[2], my_mac[3], my_mac[4], my_mac[5]);
-    msg_hello_t msg = {
-        .hdr.type = MSG_HELLO,
-    };
+static void send_hello_broadcast(void) {
+    msg_hello_t msg = {.hdr.type = MSG_HELLO, .group = SIGNAL_GROUP};
     memcpy(msg.mac, my_mac, 6);
+    hello_t1 = esp_timer_get_time();
+    msg.tx_us = hello_t1;
     esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_hello_t));  // Send HELLO message
 }
 
-void handle_hello(const uint8_t* mac_addr, const msg_hello_t* data) {
-    printf("Received HELLO from: %02x:%02x:%02x:%02x:%02x:%02x\n", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-
-    // Register peer before sending
-    if (!esp_now_is_peer_exist(mac_addr)) {
-        esp_now_peer_info_t peer = {};
-        memcpy(peer.peer_addr, mac_addr, 6);
-        peer.channel = 0;
-        peer.ifidx = ESP_IF_WIFI_STA;
-        esp_now_add_peer(&peer);
-        memcpy(other_mac, mac_addr, 6);
+// Leader: how far ahead the step start is, negative once it has begun
+static int32_t phase_lead_us(const isect_phase_t* phase) {
+    int64_t now = esp_timer_get_time();
+    return (int32_t)(clock_sync_local_at_ms(NULL, phase->start_ms, now) - now);
+}
+
+static void send_phase_broadcast(const isect_phase_t* phase, uint16_t seq, uint8_t flags) {
+    msg_phase_t msg = {.hdr = {.type = MSG_PHASE, .flags = flags, .seq = seq}, .phase = *phase};
+    msg.lead_us = phase_lead_us(phase);
+    esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_phase_t));  // Send PHASE message
+}
+
+// Announce a step to every follower and keep it for retransmits until each one has answered
+static void announce_phase(const isect_phase_t* phase) {
+    msg_phase_t msg = {.hdr = {.type = MSG_PHASE, .flags = MSG_FLAG_ACK_REQ}, .phase = *phase};
+    uint8_t to[ISECT_MAX_NODES][6];
+
+    for (int i = 1; i < node.count; i++) {
+        memcpy(to[i - 1], node.members[i].mac, 6);
     }
+    phase_seq = msg.hdr.seq = reliable_next_seq(&rel);
+    msg.lead_us = phase_lead_us(phase);
+    reliable_track(&rel, phase_seq, (const uint8_t*)&msg, sizeof(msg), to, node.count - 1, now_ms());
+    esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_phase_t));  // Send PHASE message
+}
 
-    msg_ack_t msg = {
-        .hdr.type = MSG_ACK,
-    };
-    memcpy(msg.mac, my_mac, 6);
-    determine_role_and_configure_leds();
-    esp_now_send(mac_addr, (uint8_t*)&msg, sizeof(msg_ack_t));  // Send ACK message
+static void send_ack(const uint8_t* dst, uint16_t seq) {
+    msg_ack_t msg = {.hdr.type = MSG_ACK, .seq = seq};
+    memcpy(msg.dst, dst, 6);
+    esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_ack_t));  // Send ACK message
 }
 
-void handle_ack(const uint8_t* mac_addr, const msg_ack_t* data) {
-    printf("Received ACK from: %02x:%02x:%02x:%02x:%02x:%02x\n", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-
-    if (!role_determined) {
-        if (!esp_now_is_peer_exist(mac_addr)) {
-            esp_now_peer_info_t peer = {};
-            memcpy(peer.peer_addr, mac_addr, 6);
-            peer.channel = 0;
-            peer.ifidx = ESP_IF_WIFI_STA;
-            esp_now_add_peer(&peer);
-            memcpy(other_mac, mac_addr, 6);
-        }
-        determine_role_and_configure_leds();
-    } else {
-        change_ack = false;
+static void retransmit_due(void) {
+    const uint8_t* frame;
+    uint8_t len;
+
+    if (reliable_poll(&rel, now_ms(), &frame, &len)) {
+        msg_phase_t msg;
+        // Only PHASE is tracked; its start is that much closer by now
+        memcpy(&msg, frame, sizeof(msg));
+        msg.lead_us = phase_lead_us(&msg.phase);
+        esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_phase_t));  // Send the PHASE again
     }
 }
 
-void handle_change(const uint8_t* mac_addr, const msg_change_t* data) {
-    printf("Received CHANGE from: %02x:%02x:%02x:%02x:%02x:%02x\n", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-    change_received = false;  // Release the slave from waiting
-    msg_ack_t msg = {.hdr.type = MSG_ACK};
-    esp_now_send(mac_addr, (uint8_t*)&msg, sizeof(msg_ack_t));  // Send ACK message
+static void rearm_phase_timer(void) {
+    uint32_t deadline = isect_next_deadline_ms(&node, now_ms());
+    uint32_t retry = reliable_next_deadline_ms(&rel, now_ms());
+
+    deadline = retry < deadline ? retry : deadline;
+    xTimerChangePeriod(phase_timer, deadline ? pdMS_TO_TICKS(deadline) + 1 : 1, 0);  // Also (re)starts the timer
+}
+
+static void send_sync_reply(const uint8_t* dst, int64_t t1, int64_t t2) {
+    msg_sync_t msg = {.hdr.type = MSG_SYNC, .t1 = t1, .t2 = t2};
+    memcpy(msg.dst, dst, 6);
+    msg.t3 = esp_timer_get_time();
+    esp_now_send(broadcast_mac, (uint8_t*)&msg, sizeof(msg_sync_t));  // Send SYNC message
 }
 
-void handle_heartbeat(const uint8_t* mac_addr, const msg_heartbeat_t* data) {
-    // Reset heartbeat alive timer
-    if (heartbeat_alive_timer != NULL) {
-        xTimerReset(heartbeat_alive_timer, 0);
+static void handle_sync(const ctrl_event_t* evt) {
+    const msg_sync_t* msg = &evt->sync;
+
+    // Only the answer to our last HELLO, from the leader we follow
+    if (memcmp(msg->dst, my_mac, 6) != 0 || msg->t1 != hello_t1 || memcmp(evt->mac, sync_mac, 6) != 0) {
+        return;
     }
+    clock_sync_exchange(&sync, msg->t1, msg->t2, msg->t3, evt->rx_us);
+    one_way_us = clock_sync_one_way_us(&sync);
 }
 
-void recv_cb(const esp_now_recv_info_t* recv_info, const uint8_t* data, int len) {
-    const uint8_t* mac_addr = recv_info->src_addr;
-    if (role_determined) {
-        msg_header_t* hdr = (msg_header_t*)data;
-        switch (hdr->type) {
-            case MSG_CHANGE:
-                handle_change(mac_addr, (msg_change_t*)data);
-                break;
-
-            case MSG_ACK:
-                handle_ack(mac_addr, (msg_ack_t*)data);
-                break;
-
-            case MSG_HEARTBEAT:
-                handle_heartbeat(mac_addr, (msg_heartbeat_t*)data);
-                break;
-
-            default:
-                break;
+// Carry out what the state machine asked for and re-arm the phase timer for its next deadline
+static void apply_action(const isect_action_t* action, const ctrl_event_t* rx_phase) {
+    bool leader = isect_is_leader(&node);
+
+    if (leader != was_leader) {
+        DLOG(TAG, leader ? "Leading %u heads" : "Following, %u heads", node.count);
+        was_leader = leader;
+    }
+    if (!leader && memcmp(node.members[node.leader].mac, sync_mac, 6) != 0) {
+        memcpy(sync_mac, node.members[node.leader].mac, 6);
+        clock_sync_reset(&sync);  // New reference clock
+    }
+    if (action->send_phase) {
+        DLOG(TAG, "PHASE %u: step %u for ..:%02x:%02x group %u", action->phase.cycle, action->phase.step,
+             action->phase.mac[4], action->phase.mac[5], action->phase.group);
+        announce_phase(&action->phase);
+    }
+    if (action->light_changed) {
+        schedule_light(action, leader, rx_phase);
+    }
+    rearm_phase_timer();
+}
+
+// Controller task, on the HELLO tick
+static void log_rx_stats(void) {
+    static uint32_t ticks = 0;
+    static uint32_t pool_full = 0;
+    espnow_rx_stats_t stats;
+
+    espnow_rx_get_stats(&stats);
+    if (++ticks % RX_STATS_EVERY_HELLOS != 0 && stats.pool_full == pool_full) {
+        return;
+    }
+    pool_full = stats.pool_full;
+    DLOG(TAG, "rx: received %u invalid %u pool full %u, at most %u of %u buffers in flight", stats.received,
+         stats.invalid, stats.pool_full, stats.max_in_flight, ESPNOW_RX_POOL_SIZE);
+}
+
+// Controller task: one received frame or timer event
+static void handle_event(const ctrl_event_t* evt) {
+    isect_action_t action;
+    isect_phase_t phase;
+    bool accepted;
+
+    switch (evt->type) {
+        case EVT_RX_HELLO:
+            isect_on_hello(&node, evt->mac, evt->hello.group, now_ms(), &action);
+            apply_action(&action, NULL);
+            if (isect_is_leader(&node)) {
+                send_sync_reply(evt->mac, evt->hello.tx_us, evt->rx_us);
+            }
+            break;
+
+        case EVT_RX_PHASE:
+            if (!(evt->flags & MSG_FLAG_ACK_REQ) || reliable_accept(&rel, evt->mac, evt->seq)) {
+                accepted = isect_on_phase(&node, evt->mac, &evt->phase, now_ms(), &action);
+                apply_action(&action, evt);
+            } else {
+                accepted = isect_has_phase(&node, evt->mac, &evt->phase);  // The lost one may have been our ACK
+            }
+            // An ACK tells the sender this head follows the step; a head that ignored it must not confirm it
+            if ((evt->flags & MSG_FLAG_ACK_REQ) && accepted) {
+                send_ack(evt->mac, evt->seq);
+            }
+            break;
+
+        case EVT_RX_SYNC:
+            handle_sync(evt);
+            break;
+
+        case EVT_RX_ACK:
+            if (memcmp(evt->ack.dst, my_mac, 6) == 0 && reliable_on_ack(&rel, evt->mac, evt->ack.seq)) {
+                isect_confirm(&node);
+                rearm_phase_timer();  // Nothing left to retransmit
+            }
+            break;
+
+        case EVT_HELLO_TICK:
+            send_hello_broadcast();
+            if (isect_current_phase(&node, &phase)) {
+                send_phase_broadcast(&phase, phase_seq, 0);  // Repeat for heads that joined since
+            }
+            log_rx_stats();
+            break;
+
+        case EVT_BLINK_TICK:
+            if (node.light == ISECT_LIGHT_FLASH_YELLOW) {
+                yellow_on = !yellow_on;
+                gpio_set_level(YELLOW_LED_PIN, yellow_on);
+            }
+            break;
+
+        case EVT_PHASE_DONE:
+            retransmit_due();
+            isect_poll(&node, now_ms(), &action);
+            apply_action(&action, NULL);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Single owner of the lights and the protocol state; sleeps until something happens
+void controller_task(void* arg) {
+    const isect_timing_t timing = ISECT_TIMING_DEFAULT;
+    ctrl_event_t evt;
+    uint32_t pending = 0;
+
+    isect_init(&node, my_mac, SIGNAL_GROUP, &timing, now_ms());
+    reliable_init(&rel, (uint16_t)esp_random());  // So a restarted head does not look like a stream of duplicates
+    show_light(node.light);
+    xTimerStart(yellow_timer, 0);
+    xTimerStart(hello_timer, 0);
+    send_hello_broadcast();
+
+    while (1) {
+        // Frames first, so a phase deadline is judged against the freshest member table
+        while (xQueueReceive(ctrl_queue, &evt, 0) == pdTRUE) {
+            handle_event(&evt);
         }
-    } else {
-        msg_header_t* hdr = (msg_header_t*)data;
-
-        switch (hdr->type) {
-            case MSG_HELLO:
-                handle_hello(mac_addr, (msg_hello_t*)data);
-                break;
-
-            case MSG_ACK:
-                handle_ack(mac_addr, (msg_ack_t*)data);
-                break;
-            default:
-                break;
+        for (int type = EVT_HELLO_TICK; type <= EVT_PHASE_DONE; type++) {
+            if (pending & TIMER_EVENT_BIT(type)) {
+                evt = (ctrl_event_t){.type = (uint8_t)type};
+                handle_event(&evt);
+            }
+        }
+        xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+    }
+}
+
+// Wi-Fi task: exact size per message type, anything else is dropped before it is copied
+static bool frame_is_valid(const uint8_t* data, int len) {
+    switch (data[0]) {
+        case MSG_HELLO:
+            return len == sizeof(msg_hello_t);
+        case MSG_PHASE:
+            return len == sizeof(msg_phase_t);
+        case MSG_SYNC:
+            return len == sizeof(msg_sync_t);
+        case MSG_ACK:
+            return len == sizeof(msg_ack_t);
+        default:
+            return false;
+    }
+}
+
+// Turns received frames into controller events; may block on a full controller queue, the Wi-Fi task never does
+void protocol_task(void* arg) {
+    espnow_rx_frame_t* frame;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while ((frame = espnow_rx_take()) != NULL) {
+            const msg_header_t* hdr = (const msg_header_t*)frame->data;
+            ctrl_event_t evt = {.flags = hdr->flags, .seq = hdr->seq, .rx_us = frame->rx_us};
+            memcpy(evt.mac, frame->src, 6);
+            if (frame->data[0] == MSG_HELLO) {
+                const msg_hello_t* msg = (const msg_hello_t*)frame->data;
+                evt.type = EVT_RX_HELLO;
+                evt.hello.group = msg->group;
+                evt.hello.tx_us = msg->tx_us;
+            } else if (frame->data[0] == MSG_PHASE) {
+                const msg_phase_t* msg = (const msg_phase_t*)frame->data;
+                evt.type = EVT_RX_PHASE;
+                evt.phase = msg->phase;
+                evt.lead_us = msg->lead_us;
+            } else if (frame->data[0] == MSG_SYNC) {
+                evt.type = EVT_RX_SYNC;
+                memcpy(&evt.sync, frame->data, sizeof(msg_sync_t));
+            } else {
+                evt.type = EVT_RX_ACK;
+                memcpy(&evt.ack, frame->data, sizeof(msg_ack_t));
+            }
+            espnow_rx_release(frame);
+            xQueueSend(ctrl_queue, &evt, portMAX_DELAY);
+            if (controller != NULL) {
+                xTaskNotify(controller, QUEUE_EVENT_BIT, eSetBits);
+            }
         }
     }
 }
 
+static TimerHandle_t create_timer(const char* name, uint32_t period_ms, bool reload, ctrl_event_type_t evt) {
+    return xTimerCreate(name, pdMS_TO_TICKS(period_ms), reload, (void*)(uintptr_t)evt, timer_event_cb);
+}
+
 void app_main(void) {
+    dlog_start(1);  // Drain deferred logs from the receive path at low priority
+
     gpio_set_direction(RED_LED_PIN, GPIO_MODE_OUTPUT);
     gpio_set_direction(YELLOW_LED_PIN, GPIO_MODE_OUTPUT);
     gpio_set_direction(GREEN_LED_PIN, GPIO_MODE_OUTPUT);
 
-    srand(time(NULL));
+    ctrl_queue = xQueueCreate(CONTROLLER_QUEUE_LEN, sizeof(ctrl_event_t));
+    hello_timer = create_timer("hello_timer", ISECT_HELLO_PERIOD_MS, true, EVT_HELLO_TICK);
+    phase_timer = create_timer("phase_timer", ISECT_MEMBER_TIMEOUT_MS, false, EVT_PHASE_DONE);
+    yellow_timer = create_timer("yellow_timer", BLINK_PERIOD_MS, true, EVT_BLINK_TICK);
+    const esp_timer_create_args_t switch_args = {.callback = switch_cb, .name = "switch"};
+    ESP_ERROR_CHECK(esp_timer_create(&switch_args, &switch_timer));
+
+    TaskHandle_t protocol = NULL;
+    xTaskCreate(protocol_task, "protocol", PROTOCOL_STACK_SIZE, NULL, PROTOCOL_PRIORITY, &protocol);
+
     start_wifi();
-    esp_now_init();                     // Initialize ESP-NOW
-    esp_now_register_recv_cb(recv_cb);  // Register receive callback for ESP-NOW
+    esp_now_init();                            // Initialize ESP-NOW
+    espnow_rx_init(protocol, frame_is_valid);  // Receive through the frame pool
 
     esp_wifi_get_mac(ESP_IF_WIFI_STA, my_mac);  // Get device MAC address
 
-    // Register broadcast peer for HELLO messages
+    // Register broadcast peer; every message is broadcast
     esp_now_peer_info_t broadcast_peer = {};
     memset(broadcast_peer.peer_addr, 0xFF, 6);
     broadcast_peer.channel = 0;
     broadcast_peer.ifidx = ESP_IF_WIFI_STA;
     esp_now_add_peer(&broadcast_peer);
 
-    yellow_timer = xTimerCreate("yellow_timer", pdMS_TO_TICKS(500), pdTRUE, NULL, yellow_timer_cb);
     vTaskDelay(1000 / portTICK_PERIOD_MS);  // Wait a moment before starting
-
-    while (1) {
-        if (!role_determined) {
-            gpio_set_level(RED_LED_PIN, 0);
-            gpio_set_level(GREEN_LED_PIN, 0);
-            gpio_set_level(YELLOW_LED_PIN, 0);
-            xTimerStart(yellow_timer, 0);
-        }
-
-        while (!role_determined) {
-            send_hello_broadcast();  // Broadcast HELLO messages until role is determined
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
-
-        int green_duration = rand() % 5000 + 5000;  // Random green duration between 5-10 seconds
-        if (is_master) {
-            printf("MASTER: Starting green light cycle\n");
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            gpio_set_level(RED_LED_PIN, 1);
-            gpio_set_level(YELLOW_LED_PIN, 1);
-            gpio_set_level(GREEN_LED_PIN, 0);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-
-            gpio_set_level(RED_LED_PIN, 0);
-            gpio_set_level(YELLOW_LED_PIN, 0);
-            gpio_set_level(GREEN_LED_PIN, 1);
-            vTaskDelay(pdMS_TO_TICKS(green_duration));
-            gpio_set_level(GREEN_LED_PIN, 0);
-            gpio_set_level(YELLOW_LED_PIN, 1);
-            vTaskDelay(pdMS_TO_TICKS(2000));
-
-            printf("MASTER: Sending CHANGE to slave\n");
-            msg_change_t msg = {.hdr.type = MSG_CHANGE, .flag = 1};
-            esp_now_send(other_mac, (uint8_t*)&msg, sizeof(msg_change_t));  // Send CHANGE message
-            while (change_ack && role_determined) {
-                vTaskDelay(pdMS_TO_TICKS(100));
-            }
-
-            if (role_determined) {
-                change_ack = true;
-                is_master = false;  // Swap role: master becomes slave
-                printf("MASTER: Became SLAVE\n");
-            }
-        } else {
-            printf("SLAVE: Waiting for CHANGE signal\n");
-            gpio_set_level(RED_LED_PIN, 1);
-            gpio_set_level(YELLOW_LED_PIN, 0);
-            gpio_set_level(GREEN_LED_PIN, 0);
-            while (change_received && role_determined) {
-                vTaskDelay(pdMS_TO_TICKS(100));
-            }
-            if (role_determined) {
-                change_received = true;
-                is_master = true;  // Swap role: slave becomes master
-                printf("SLAVE: Became MASTER\n");
-            }
-        }
-    }
-}
\ No newline at end of file
+    xTaskCreate(controller_task, "controller", CONTROLLER_STACK_SIZE, NULL, CONTROLLER_PRIORITY, &controller);
+}
@@ -0,0 +1,96 @@
+#include "clock_sync.h"
+
+#include <string.h>
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static int64_t drift_us(const clock_sync_t* cs, int64_t local_us) {
+    return (local_us - cs->base_local_us) * cs->drift_ppb / 1000000000;
+}
+
+static const clock_sync_sample_t* best_sample(const clock_sync_t* cs) {
+    const clock_sync_sample_t* best = &cs->samples[0];
+
+    for (int i = 1; i < cs->count; i++) {
+        if (cs->samples[i].delay_us < best->delay_us) {
+            best = &cs->samples[i];
+        }
+    }
+    return best;
+}
+
+static void update_drift(clock_sync_t* cs, const clock_sync_sample_t* best) {
+    int64_t span = best->local_us - cs->anchor_local_us;
+    int64_t ppb;
+
+    if (!cs->have_anchor) {
+        cs->anchor_local_us = best->local_us;
+        cs->anchor_offset_us = best->offset_us;
+        cs->have_anchor = true;
+        return;
+    }
+    if (span < CLOCK_SYNC_DRIFT_SPAN_US) {
+        return;
+    }
+
+    ppb = (best->offset_us - cs->anchor_offset_us) * 1000000000 / span;
+    if (ppb > CLOCK_SYNC_MAX_DRIFT_PPB) {
+        ppb = CLOCK_SYNC_MAX_DRIFT_PPB;
+    } else if (ppb < -CLOCK_SYNC_MAX_DRIFT_PPB) {
+        ppb = -CLOCK_SYNC_MAX_DRIFT_PPB;
+    }
+    cs->drift_ppb = cs->have_drift ? (int32_t)(cs->drift_ppb + (ppb - cs->drift_ppb) / CLOCK_SYNC_DRIFT_SMOOTHING)
+                                   : (int32_t)ppb;
+    cs->have_drift = true;
+    cs->anchor_local_us = best->local_us;
+    cs->anchor_offset_us = best->offset_us;
+}
+
+void clock_sync_reset(clock_sync_t* cs) {
+    memset(cs, 0, sizeof(*cs));
+}
+
+void clock_sync_exchange(clock_sync_t* cs, int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    clock_sync_sample_t* s = &cs->samples[cs->next];
+    int64_t delay = (t4 - t1) - (t3 - t2);
+
+    s->local_us = t4;
+    s->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    s->delay_us = delay > 0 ? delay : 0;
+
+    cs->next = (uint8_t)((cs->next + 1) % CLOCK_SYNC_WINDOW);
+    if (cs->count < CLOCK_SYNC_WINDOW) {
+        cs->count++;
+    }
+
+    const clock_sync_sample_t* best = best_sample(cs);
+    update_drift(cs, best);
+    cs->base_local_us = best->local_us;
+    cs->offset_us = best->offset_us;
+    cs->valid = true;
+}
+
+int64_t clock_sync_to_ref(const clock_sync_t* cs, int64_t local_us) {
+    return local_us + cs->offset_us + drift_us(cs, local_us);
+}
+
+int64_t clock_sync_to_local(const clock_sync_t* cs, int64_t ref_us) {
+    // One fixed point step; the error is drift squared
+    int64_t local = ref_us - cs->offset_us;
+    return ref_us - cs->offset_us - drift_us(cs, local);
+}
+
+int64_t clock_sync_one_way_us(const clock_sync_t* cs) {
+    return cs->count > 0 ? best_sample(cs)->delay_us / 2 : CLOCK_SYNC_DEFAULT_ONE_WAY_US;
+}
+
+int64_t clock_sync_local_at_ms(const clock_sync_t* cs, uint32_t ref_ms, int64_t local_now_us) {
+    int64_t ref_now_us = cs != NULL ? clock_sync_to_ref(cs, local_now_us) : local_now_us;
+    int64_t ref_now_ms = floor_div(ref_now_us, 1000);
+    int64_t ref_us = (ref_now_ms + (int32_t)(ref_ms - (uint32_t)ref_now_ms)) * 1000;
+
+    return cs != NULL ? clock_sync_to_local(cs, ref_us) : ref_us;
+}
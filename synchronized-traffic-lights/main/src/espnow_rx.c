@@ -0,0 +1,101 @@
+#include "espnow_rx.h"
+
+#include <esp_now.h>
+#include <esp_timer.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define RING_MASK (ESPNOW_RX_POOL_SIZE - 1)
+
+_Static_assert((ESPNOW_RX_POOL_SIZE & RING_MASK) == 0, "ESPNOW_RX_POOL_SIZE must be a power of two");
+_Static_assert(ESPNOW_RX_MAX_LEN <= UINT8_MAX, "frame length is kept in a byte");
+
+// Single producer / single consumer ring of pool indices
+typedef struct {
+    atomic_uint head;  // written by the producer
+    atomic_uint tail;  // written by the consumer
+    uint8_t slots[ESPNOW_RX_POOL_SIZE];
+} index_ring_t;
+
+static espnow_rx_frame_t pool[ESPNOW_RX_POOL_SIZE];
+static index_ring_t ready;      // Wi-Fi task -> consumer
+static index_ring_t free_ring;  // consumer -> Wi-Fi task
+static TaskHandle_t consumer_task = NULL;
+static espnow_rx_validate_t validate_cb = NULL;
+
+static atomic_uint stat_received;
+static atomic_uint stat_invalid;
+static atomic_uint stat_pool_full;
+static atomic_uint stat_max_in_flight;  // written by the Wi-Fi task only
+
+// The ring holds at most ESPNOW_RX_POOL_SIZE indices, so it can never overflow
+static void ring_push(index_ring_t* ring, uint8_t idx) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->slots[head & RING_MASK] = idx;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static bool ring_pop(index_ring_t* ring, uint8_t* idx) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        return false;
+    }
+    *idx = ring->slots[tail & RING_MASK];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void recv_cb(const esp_now_recv_info_t* recv_info, const uint8_t* data, int len) {
+    uint8_t idx;
+
+    if (len <= 0 || len > ESPNOW_RX_MAX_LEN || !validate_cb(data, len)) {
+        atomic_fetch_add_explicit(&stat_invalid, 1, memory_order_relaxed);
+        return;
+    }
+    if (!ring_pop(&free_ring, &idx)) {
+        atomic_fetch_add_explicit(&stat_pool_full, 1, memory_order_relaxed);
+        return;
+    }
+    // Only the Wi-Fi task pops free buffers; a release still in progress counts as in flight
+    unsigned in_flight = ESPNOW_RX_POOL_SIZE - (atomic_load_explicit(&free_ring.head, memory_order_acquire) -
+                                                atomic_load_explicit(&free_ring.tail, memory_order_relaxed));
+    if (in_flight > atomic_load_explicit(&stat_max_in_flight, memory_order_relaxed)) {
+        atomic_store_explicit(&stat_max_in_flight, in_flight, memory_order_relaxed);
+    }
+
+    espnow_rx_frame_t* frame = &pool[idx];
+    memcpy(frame->src, recv_info->src_addr, 6);
+    frame->len = (uint8_t)len;
+    frame->rssi = recv_info->rx_ctrl != NULL ? (int8_t)recv_info->rx_ctrl->rssi : 0;
+    frame->rx_us = esp_timer_get_time();
+    memcpy(frame->data, data, len);
+
+    ring_push(&ready, idx);
+    atomic_fetch_add_explicit(&stat_received, 1, memory_order_relaxed);
+    xTaskNotifyGive(consumer_task);
+}
+
+esp_err_t espnow_rx_init(TaskHandle_t consumer, espnow_rx_validate_t validate) {
+    consumer_task = consumer;
+    validate_cb = validate;
+    for (int i = 0; i < ESPNOW_RX_POOL_SIZE; i++) {
+        ring_push(&free_ring, (uint8_t)i);
+    }
+    return esp_now_register_recv_cb(recv_cb);
+}
+
+espnow_rx_frame_t* espnow_rx_take(void) {
+    uint8_t idx;
+    return ring_pop(&ready, &idx) ? &pool[idx] : NULL;
+}
+
+void espnow_rx_release(espnow_rx_frame_t* frame) {
+    ring_push(&free_ring, (uint8_t)(frame - pool));
+}
+
+void espnow_rx_get_stats(espnow_rx_stats_t* stats) {
+    stats->received = atomic_load_explicit(&stat_received, memory_order_relaxed);
+    stats->invalid = atomic_load_explicit(&stat_invalid, memory_order_relaxed);
+    stats->pool_full = atomic_load_explicit(&stat_pool_full, memory_order_relaxed);
+    stats->max_in_flight = atomic_load_explicit(&stat_max_in_flight, memory_order_relaxed);
+}
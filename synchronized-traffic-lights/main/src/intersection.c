@@ -0,0 +1,402 @@
+#include "intersection.h"
+
+#include <string.h>
+
+static bool time_reached(uint32_t now_ms, uint32_t deadline_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+static uint32_t next_random(isect_node_t* node) {
+    // xorshift32
+    uint32_t x = node->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    node->rng = x;
+    return x;
+}
+
+static int member_find(const isect_node_t* node, const uint8_t mac[6]) {
+    for (int i = 0; i < node->count; i++) {
+        if (memcmp(node->members[i].mac, mac, 6) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Lowest MAC wins; every node with the same table picks the same leader
+static void elect(isect_node_t* node) {
+    uint8_t leader = 0;
+    for (uint8_t i = 1; i < node->count; i++) {
+        if (memcmp(node->members[i].mac, node->members[leader].mac, 6) < 0) {
+            leader = i;
+        }
+    }
+    node->leader = leader;
+}
+
+// A plan entry is a head of its own, or the lowest MAC head of a shared group
+static bool is_entry(const isect_node_t* node, int i) {
+    const isect_member_t* m = &node->members[i];
+    if (m->group == ISECT_GROUP_OWN) {
+        return true;
+    }
+    for (int j = 0; j < node->count; j++) {
+        if (node->members[j].group == m->group && memcmp(node->members[j].mac, m->mac, 6) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Entry following the one identified by mac, in MAC order, wrapping around
+static int next_entry(const isect_node_t* node, const uint8_t mac[6]) {
+    int first = -1;
+    int next = -1;
+
+    for (int i = 0; i < node->count; i++) {
+        if (!is_entry(node, i)) {
+            continue;
+        }
+        const uint8_t* m = node->members[i].mac;
+        if (first < 0 || memcmp(m, node->members[first].mac, 6) < 0) {
+            first = i;
+        }
+        if (memcmp(m, mac, 6) > 0 && (next < 0 || memcmp(m, node->members[next].mac, 6) < 0)) {
+            next = i;
+        }
+    }
+    return next >= 0 ? next : first;
+}
+
+// Whether a head with this MAC and group shows the colours of the phase's entry
+static bool in_entry(const isect_phase_t* phase, const uint8_t mac[6], uint8_t group) {
+    return phase->group != ISECT_GROUP_OWN ? phase->group == group : memcmp(phase->mac, mac, 6) == 0;
+}
+
+static void set_light(isect_node_t* node, isect_light_t light, isect_action_t* action) {
+    if (node->light != light) {
+        node->light = light;
+        action->light_changed = true;
+    }
+    action->light = node->light;
+}
+
+static void apply_phase(isect_node_t* node, const uint8_t src[6], const isect_phase_t* phase, isect_action_t* action) {
+    static const isect_light_t active[ISECT_STEP_COUNT] = {
+        [ISECT_STEP_RED_YELLOW] = ISECT_LIGHT_RED_YELLOW,
+        [ISECT_STEP_GREEN] = ISECT_LIGHT_GREEN,
+        [ISECT_STEP_YELLOW] = ISECT_LIGHT_YELLOW,
+        [ISECT_STEP_ALL_RED] = ISECT_LIGHT_RED,
+    };
+    const isect_member_t* me = &node->members[0];
+    bool mine = in_entry(phase, me->mac, me->group);
+
+    node->phase = *phase;
+    node->have_phase = true;
+    node->phase_expired = false;
+    memcpy(node->phase_src, src, 6);
+    set_light(node, mine && phase->step < ISECT_STEP_COUNT ? active[phase->step] : ISECT_LIGHT_RED, action);
+    if (action->light_changed) {
+        action->scheduled = true;
+        action->start_ms = phase->start_ms;
+    }
+}
+
+static uint32_t step_duration(isect_node_t* node, isect_step_t step) {
+    switch (step) {
+        case ISECT_STEP_RED_YELLOW:
+            return node->timing.red_yellow_ms;
+        case ISECT_STEP_GREEN:
+            return node->timing.green_ms +
+                   (node->timing.green_jitter_ms ? next_random(node) % node->timing.green_jitter_ms : 0);
+        case ISECT_STEP_YELLOW:
+            return node->timing.yellow_ms;
+        default:
+            return node->timing.all_red_ms;
+    }
+}
+
+// Latest time a head that stops hearing PHASE now has turned red by its own timeout
+static uint32_t clear_after(uint32_t last_phase_ms) {
+    return last_phase_ms + ISECT_PHASE_TIMEOUT_MS + ISECT_SWITCH_LEAD_MS;
+}
+
+static void drive_step(isect_node_t* node, isect_phase_t* phase, uint32_t start_ms, isect_action_t* action) {
+    phase->cycle = (uint16_t)(node->phase.cycle + 1);
+    phase->duration_ms = step_duration(node, (isect_step_t)phase->step);
+    phase->start_ms = start_ms;
+    node->step_end_ms = start_ms + phase->duration_ms;
+    for (int i = 1; i < node->count; i++) {
+        isect_member_t* m = &node->members[i];
+        if (phase->step == ISECT_STEP_ALL_RED) {
+            m->asked = true;
+        } else if (phase->step == ISECT_STEP_RED_YELLOW && in_entry(phase, m->mac, m->group)) {
+            m->red = false;
+        }
+    }
+    // A held head of this entry may hear the step, and its repeats until step_end_ms
+    for (int i = 0; i < node->held_count; i++) {
+        isect_held_t* h = &node->held[i];
+        if (phase->step != ISECT_STEP_ALL_RED && in_entry(phase, h->mac, h->group) &&
+            time_reached(clear_after(node->step_end_ms), h->clear_ms)) {
+            h->clear_ms = clear_after(node->step_end_ms);
+        }
+    }
+    apply_phase(node, node->members[0].mac, phase, action);
+    action->send_phase = true;
+    action->phase = node->phase;
+}
+
+// Someone else leads now; what this head was driving no longer counts
+static void stop_driving(isect_node_t* node, isect_action_t* action) {
+    if (node->driving) {
+        node->driving = false;
+        node->have_phase = false;
+        set_light(node, ISECT_LIGHT_RED, action);
+    }
+}
+
+// Every head has confirmed red since its entry was last served, and none that may not have is held
+static bool all_red(const isect_node_t* node) {
+    for (int i = 1; i < node->count; i++) {
+        if (!node->members[i].red) {
+            return false;
+        }
+    }
+    return node->held_count == 0;
+}
+
+static void hold(isect_node_t* node, const isect_member_t* m, uint32_t now_ms) {
+    uint32_t last_phase_ms = now_ms;
+
+    if (node->held_count >= ISECT_MAX_NODES) {
+        return;
+    }
+    // The entry it may show is still running: the leader keeps naming it until the step ends
+    if (node->phase.step != ISECT_STEP_ALL_RED && in_entry(&node->phase, m->mac, m->group) &&
+        !time_reached(now_ms, node->step_end_ms)) {
+        last_phase_ms = node->step_end_ms;
+    }
+    isect_held_t* h = &node->held[node->held_count++];
+    memcpy(h->mac, m->mac, 6);
+    h->group = m->group;
+    h->clear_ms = clear_after(last_phase_ms);
+}
+
+static void leader_poll(isect_node_t* node, uint32_t now_ms, isect_action_t* action) {
+    isect_phase_t phase;
+
+    if (!node->driving) {
+        // Take over: clear the intersection first, continuing from whatever was last shown.
+        // Nobody has confirmed red to this leader yet.
+        node->driving = true;
+        for (int i = 1; i < node->count; i++) {
+            node->members[i].red = false;
+        }
+        phase = node->phase;
+        if (!node->have_phase) {
+            memcpy(phase.mac, node->members[0].mac, 6);
+            phase.group = node->members[0].group;
+        }
+        phase.step = ISECT_STEP_ALL_RED;
+        drive_step(node, &phase, now_ms + ISECT_SWITCH_LEAD_MS, action);
+        return;
+    }
+    // Announce the next step ahead of its start, which is the end of the current one
+    if (!time_reached(now_ms, node->step_end_ms - ISECT_SWITCH_LEAD_MS)) {
+        return;
+    }
+
+    phase = node->phase;
+    if (phase.step + 1 < ISECT_STEP_COUNT) {
+        phase.step++;
+    } else if (!all_red(node)) {
+        // Some head may still show the last entry's colours: stay all red and ask again
+        phase.step = ISECT_STEP_ALL_RED;
+    } else {
+        int entry = next_entry(node, phase.mac);
+        memcpy(phase.mac, node->members[entry].mac, 6);
+        phase.group = node->members[entry].group;
+        phase.step = ISECT_STEP_RED_YELLOW;
+    }
+    drive_step(node, &phase, node->step_end_ms, action);
+}
+
+void isect_init(isect_node_t* node, const uint8_t mac[6], uint8_t group, const isect_timing_t* timing, uint32_t now_ms) {
+    memset(node, 0, sizeof(*node));
+    node->timing = *timing;
+    memcpy(node->members[0].mac, mac, 6);
+    node->members[0].group = group;
+    node->members[0].last_seen_ms = now_ms;
+    node->count = 1;
+    node->light = ISECT_LIGHT_FLASH_YELLOW;
+    node->rng = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) | 1;
+}
+
+void isect_on_hello(isect_node_t* node, const uint8_t mac[6], uint8_t group, uint32_t now_ms, isect_action_t* action) {
+    int i = member_find(node, mac);
+
+    if (i < 0 && node->count < ISECT_MAX_NODES) {
+        i = node->count++;
+        memcpy(node->members[i].mac, mac, 6);
+        // Unknown colours, even when it was held: the next ALL_RED waits for it
+        node->members[i].red = false;
+        node->members[i].asked = false;
+        for (int h = 0; h < node->held_count; h++) {
+            if (memcmp(node->held[h].mac, mac, 6) == 0) {
+                node->held[h] = node->held[--node->held_count];
+                break;
+            }
+        }
+    }
+    if (i > 0) {
+        node->members[i].group = group;
+        node->members[i].last_seen_ms = now_ms;
+    }
+    isect_poll(node, now_ms, action);
+}
+
+static bool is_followed(const isect_node_t* node, const uint8_t src[6]) {
+    return node->leader != 0 && memcmp(src, node->members[node->leader].mac, 6) == 0;
+}
+
+bool isect_on_phase(isect_node_t* node, const uint8_t src[6], const isect_phase_t* phase, uint32_t now_ms,
+                    isect_action_t* action) {
+    memset(action, 0, sizeof(*action));
+    action->light = node->light;
+
+    // A lower MAC still driving was dropped here by mistake, after lost HELLOs. Take it back
+    // before following anyone else; its next HELLO fills in the group.
+    if (member_find(node, src) < 0 && memcmp(src, node->members[node->leader].mac, 6) < 0 &&
+        node->count < ISECT_MAX_NODES) {
+        isect_member_t* m = &node->members[node->count++];
+        memcpy(m->mac, src, 6);
+        m->group = ISECT_GROUP_OWN;
+        m->last_seen_ms = now_ms;
+        m->red = false;
+        m->asked = false;
+        elect(node);
+        stop_driving(node, action);
+    }
+
+    // Only the leader this node believes in drives it
+    if (!is_followed(node, src)) {
+        return false;
+    }
+    node->members[node->leader].last_seen_ms = now_ms;
+    if (node->have_phase && memcmp(node->phase_src, src, 6) == 0) {
+        int16_t age = (int16_t)(node->phase.cycle - phase->cycle);
+        // A repeat overtaken by the next step on the air
+        if (age > 0) {
+            return false;
+        }
+        // The step the fail-safe ended: stay red, the leader is back
+        if (age == 0 && node->phase_expired) {
+            node->phase_seen_ms = now_ms;
+            return true;
+        }
+    }
+    node->phase_seen_ms = now_ms;
+    apply_phase(node, src, phase, action);
+    return true;
+}
+
+bool isect_has_phase(const isect_node_t* node, const uint8_t src[6], const isect_phase_t* phase) {
+    return is_followed(node, src) && node->have_phase && memcmp(node->phase_src, src, 6) == 0 &&
+           node->phase.cycle == phase->cycle && node->phase.step == phase->step &&
+           node->phase.start_ms == phase->start_ms;
+}
+
+void isect_poll(isect_node_t* node, uint32_t now_ms, isect_action_t* action) {
+    memset(action, 0, sizeof(*action));
+    action->light = node->light;
+
+    for (int i = 1; i < node->count;) {
+        if (time_reached(now_ms, node->members[i].last_seen_ms + ISECT_MEMBER_TIMEOUT_MS)) {
+            // Lost HELLOs do not mean it is off; until it is known red it holds up the next entry
+            if (node->driving && !node->members[i].red) {
+                hold(node, &node->members[i], now_ms);
+            }
+            node->members[i] = node->members[--node->count];
+        } else {
+            i++;
+        }
+    }
+    for (int i = 0; i < node->held_count;) {
+        if (time_reached(now_ms, node->held[i].clear_ms)) {
+            node->held[i] = node->held[--node->held_count];
+        } else {
+            i++;
+        }
+    }
+    elect(node);
+
+    if (node->count < 2) {
+        node->driving = false;
+        node->have_phase = false;
+        set_light(node, node->joined ? ISECT_LIGHT_RED : ISECT_LIGHT_FLASH_YELLOW, action);
+        return;
+    }
+    node->joined = true;
+    if (node->leader != 0) {
+        stop_driving(node, action);
+        // Fail-safe: the leader is gone or out of range, whatever it said last may be over
+        if (node->have_phase && time_reached(now_ms, node->phase_seen_ms + ISECT_PHASE_TIMEOUT_MS)) {
+            node->phase_expired = true;
+        }
+        if (!node->have_phase || node->phase_expired) {
+            set_light(node, ISECT_LIGHT_RED, action);
+        }
+        return;
+    }
+    leader_poll(node, now_ms, action);
+}
+
+uint32_t isect_next_deadline_ms(const isect_node_t* node, uint32_t now_ms) {
+    uint32_t next = ISECT_MEMBER_TIMEOUT_MS;
+
+    for (int i = 1; i < node->count; i++) {
+        uint32_t expiry = node->members[i].last_seen_ms + ISECT_MEMBER_TIMEOUT_MS;
+        uint32_t left = time_reached(now_ms, expiry) ? 0 : expiry - now_ms;
+        next = left < next ? left : next;
+    }
+    for (int i = 0; i < node->held_count; i++) {
+        uint32_t left = time_reached(now_ms, node->held[i].clear_ms) ? 0 : node->held[i].clear_ms - now_ms;
+        next = left < next ? left : next;
+    }
+    if (node->driving) {
+        uint32_t announce = node->step_end_ms - ISECT_SWITCH_LEAD_MS;
+        uint32_t left = time_reached(now_ms, announce) ? 0 : announce - now_ms;
+        next = left < next ? left : next;
+    } else if (node->leader != 0 && node->have_phase && !node->phase_expired) {
+        uint32_t expiry = node->phase_seen_ms + ISECT_PHASE_TIMEOUT_MS;
+        uint32_t left = time_reached(now_ms, expiry) ? 0 : expiry - now_ms;
+        next = left < next ? left : next;
+    }
+    return next;
+}
+
+void isect_confirm(isect_node_t* node) {
+    if (!node->driving || node->phase.step != ISECT_STEP_ALL_RED) {
+        return;
+    }
+    for (int i = 1; i < node->count; i++) {
+        if (node->members[i].asked) {
+            node->members[i].red = true;
+        }
+    }
+}
+
+bool isect_is_leader(const isect_node_t* node) {
+    return node->count >= 2 && node->leader == 0;
+}
+
+bool isect_current_phase(const isect_node_t* node, isect_phase_t* phase) {
+    if (!node->driving) {
+        return false;
+    }
+    *phase = node->phase;
+    return true;
+}
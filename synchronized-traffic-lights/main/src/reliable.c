@@ -0,0 +1,126 @@
+#include "reliable.h"
+
+#include <string.h>
+
+static bool time_reached(uint32_t now_ms, uint32_t deadline_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+static void drop_waiting(reliable_t* rel, int i) {
+    memcpy(rel->waiting[i], rel->waiting[--rel->waiting_count], 6);
+    if (rel->waiting_count == 0) {
+        rel->pending = false;
+        rel->stats.delivered++;
+    }
+}
+
+void reliable_init(reliable_t* rel, uint16_t first_seq) {
+    memset(rel, 0, sizeof(*rel));
+    rel->tx_seq = first_seq;
+}
+
+uint16_t reliable_next_seq(reliable_t* rel) {
+    return rel->tx_seq++;
+}
+
+void reliable_track(reliable_t* rel, uint16_t seq, const uint8_t* frame, uint8_t len, const uint8_t (*to)[6],
+                    uint8_t count, uint32_t now_ms) {
+    if (rel->pending) {
+        rel->stats.gave_up++;  // superseded before everyone answered
+    }
+    rel->stats.sent++;
+    rel->pending = count > 0 && len <= RELIABLE_MAX_FRAME;
+    if (!rel->pending) {
+        return;
+    }
+
+    rel->seq = seq;
+    memcpy(rel->frame, frame, len);
+    rel->len = len;
+    rel->waiting_count = count < RELIABLE_MAX_PEERS ? count : RELIABLE_MAX_PEERS;
+    memcpy(rel->waiting, to, (size_t)rel->waiting_count * 6);
+    rel->interval_ms = RELIABLE_RETRY_MS;
+    rel->retry_at_ms = now_ms + RELIABLE_RETRY_MS;
+    rel->retries = 0;
+}
+
+bool reliable_on_ack(reliable_t* rel, const uint8_t src[6], uint16_t seq) {
+    if (!rel->pending || seq != rel->seq) {
+        return false;
+    }
+    for (int i = 0; i < rel->waiting_count; i++) {
+        if (memcmp(rel->waiting[i], src, 6) == 0) {
+            drop_waiting(rel, i);
+            return !rel->pending;
+        }
+    }
+    return false;
+}
+
+bool reliable_accept(reliable_t* rel, const uint8_t src[6], uint16_t seq) {
+    reliable_rx_peer_t* peer = NULL;
+    reliable_rx_peer_t* free_slot = NULL;
+
+    for (int i = 0; i < RELIABLE_MAX_PEERS; i++) {
+        if (rel->peers[i].valid && memcmp(rel->peers[i].mac, src, 6) == 0) {
+            peer = &rel->peers[i];
+            break;
+        }
+        if (!rel->peers[i].valid && free_slot == NULL) {
+            free_slot = &rel->peers[i];
+        }
+    }
+
+    if (peer != NULL) {
+        int16_t ahead = (int16_t)(seq - peer->last_seq);
+        if (ahead <= 0 && -ahead < RELIABLE_DUP_WINDOW) {
+            uint32_t bit = 1u << -ahead;
+            if (peer->seen & bit) {
+                rel->stats.duplicates++;
+                return false;
+            }
+            peer->seen |= bit;
+            return true;
+        }
+        if (ahead > 0 && ahead < RELIABLE_DUP_WINDOW) {
+            peer->seen = (peer->seen << ahead) | 1;
+            peer->last_seq = seq;
+            return true;
+        }
+        // Far ahead, or far behind because the peer restarted: start over
+    } else {
+        // A full table only costs duplicate suppression for the extra peers
+        peer = free_slot != NULL ? free_slot : &rel->peers[seq % RELIABLE_MAX_PEERS];
+        memcpy(peer->mac, src, 6);
+        peer->valid = true;
+    }
+    peer->last_seq = seq;
+    peer->seen = 1;
+    return true;
+}
+
+bool reliable_poll(reliable_t* rel, uint32_t now_ms, const uint8_t** frame, uint8_t* len) {
+    if (!rel->pending || !time_reached(now_ms, rel->retry_at_ms)) {
+        return false;
+    }
+    if (rel->retries >= RELIABLE_MAX_RETRIES) {
+        rel->pending = false;
+        rel->stats.gave_up++;
+        return false;
+    }
+
+    rel->retries++;
+    rel->stats.retransmits++;
+    rel->interval_ms *= 2;
+    rel->retry_at_ms = now_ms + rel->interval_ms;
+    *frame = rel->frame;
+    *len = rel->len;
+    return true;
+}
+
+uint32_t reliable_next_deadline_ms(const reliable_t* rel, uint32_t now_ms) {
+    if (!rel->pending) {
+        return UINT32_MAX;
+    }
+    return time_reached(now_ms, rel->retry_at_ms) ? 0 : rel->retry_at_ms - now_ms;
+}